@@ -0,0 +1,33 @@
+#ifndef Fern_Ast_Annotation_hpp
+#define Fern_Ast_Annotation_hpp
+
+#include <Roots/_defines.hpp>
+#include <string>
+#include <vector>
+#include "../Parse/SourceLocation.hpp"
+#include "llvm/Support/raw_ostream.h"
+
+namespace fern {
+
+// `@name` or `@name(arg, ...)` placed before a `func` or `extern`, or before the
+// block of an `if` or `else` branch
+struct Annotation {
+  std::string name;
+  std::vector<std::string> args;
+  SourceLocation loc;
+
+  Annotation(std::string name, std::vector<std::string> args, SourceLocation loc) :
+      name(name), args(args), loc(loc) {}
+
+  void print(llvm::raw_fd_ostream &out, usize indent) const {
+    out.indent(indent) << "Annotation: '@" << name << "'";
+    for (auto &arg: args) {
+      out << " '" << arg << "'";
+    }
+    out << "\n";
+  }
+};
+
+} // namespace fern
+
+#endif
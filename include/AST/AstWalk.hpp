@@ -0,0 +1,48 @@
+#ifndef Fern_Ast_AstWalk_hpp
+#define Fern_Ast_AstWalk_hpp
+
+#include <functional>
+#include <memory>
+#include "Nodes.hpp"
+
+namespace fern {
+
+// visits `node` and every expression beneath it in pre-order
+inline auto walkAst(const std::shared_ptr<AstNode> &node,
+                    const std::function<void(AstNode &)> &fn) -> void {
+  if (!node) {
+    return;
+  }
+
+  fn(*node);
+
+  if (auto bin = node->as<BinaryNode>()) {
+    walkAst(bin->getLhs(), fn);
+    walkAst(bin->getRhs(), fn);
+  } else if (auto unary = node->as<UnaryNode>()) {
+    walkAst(unary->getOperand(), fn);
+  } else if (auto ifNode = node->as<IfNode>()) {
+    walkAst(ifNode->getCondition(), fn);
+    walkAst(ifNode->getThenBlock(), fn);
+    walkAst(ifNode->getElseBlock(), fn);
+  } else if (auto let = node->as<LetNode>()) {
+    walkAst(let->getValue(), fn);
+  } else if (auto block = node->as<BlockNode>()) {
+    for (auto &stmt: block->getNodes()) {
+      walkAst(stmt, fn);
+    }
+  } else if (auto single = node->as<SingleOpNode>()) {
+    walkAst(single->getExpr(), fn);
+  } else if (auto call = node->as<CallNode>()) {
+    for (auto &arg: call->getArgs()) {
+      walkAst(arg, fn);
+    }
+  } else if (auto subscript = node->as<SubscriptNode>()) {
+    walkAst(subscript->getOperand(), fn);
+    walkAst(subscript->getIndex(), fn);
+  }
+}
+
+} // namespace fern
+
+#endif
@@ -3,14 +3,21 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include "../Parse/Lex/Token.hpp"
+#include "Annotation.hpp"
 #include "AstNode.hpp"
 #include "../Sema/TypeVisitor.hpp"
 
 namespace fern {
 
+// how likely the then branch of an `if` is to be taken
+enum class BranchHint : u8 { None, Likely, Unlikely };
+
+// `if cond @likely { ... } else @unlikely { ... }`, either branch may be annotated
 class IfNode : public AstNode {
   std::shared_ptr<AstNode> condition, thenBlock, elseBlock;
+  std::vector<Annotation> thenAnnotations, elseAnnotations;
 
 public:
   IfNode(SourceLocation loc, std::shared_ptr<AstNode> condition,
@@ -21,7 +28,13 @@ public:
   auto print(llvm::raw_fd_ostream &out, usize indent) const -> void override {
     out.indent(indent) << "IfNode:\n";
     condition->print(out, indent + 1);
+    for (auto &annotation: thenAnnotations) {
+      annotation.print(out, indent + 1);
+    }
     thenBlock->print(out, indent + 1);
+    for (auto &annotation: elseAnnotations) {
+      annotation.print(out, indent + 1);
+    }
     if (elseBlock) {
       elseBlock->print(out, indent + 1);
     }
@@ -34,6 +47,35 @@ public:
   auto getThenBlock() const -> std::shared_ptr<AstNode> { return thenBlock; }
   auto hasElseBlock() const -> bool { return elseBlock != nullptr; }
   auto getElseBlock() const -> std::shared_ptr<AstNode> { return elseBlock; }
+
+  auto setThenAnnotations(std::vector<Annotation> annotations) -> void {
+    thenAnnotations = std::move(annotations);
+  }
+  auto setElseAnnotations(std::vector<Annotation> annotations) -> void {
+    elseAnnotations = std::move(annotations);
+  }
+  auto getThenAnnotations() const -> const std::vector<Annotation> & { return thenAnnotations; }
+  auto getElseAnnotations() const -> const std::vector<Annotation> & { return elseAnnotations; }
+
+  // `@likely` on the else branch makes the then branch unlikely and the other way
+  // round. sema rejects branches that contradict each other
+  auto getHint() const -> BranchHint {
+    for (auto &annotation: thenAnnotations) {
+      if (annotation.name == "likely") {
+        return BranchHint::Likely;
+      } else if (annotation.name == "unlikely") {
+        return BranchHint::Unlikely;
+      }
+    }
+    for (auto &annotation: elseAnnotations) {
+      if (annotation.name == "likely") {
+        return BranchHint::Unlikely;
+      } else if (annotation.name == "unlikely") {
+        return BranchHint::Likely;
+      }
+    }
+    return BranchHint::None;
+  }
 };
 
 } // namespace fern
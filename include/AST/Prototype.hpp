@@ -9,6 +9,7 @@
 #include "../Parse/SourceLocation.hpp"
 #include "../Sema/Type.hpp"
 #include "../Sema/TypeVisitor.hpp"
+#include "Annotation.hpp"
 #include "llvm/IR/Function.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -31,6 +32,8 @@ class Prototype {
   std::vector<std::shared_ptr<PrototypeArg>> args;
   Type returnType;
   SourceLocation loc;
+  std::vector<Annotation> annotations;
+  bool external = false;
 
 public:
   Prototype(std::string name, std::vector<std::shared_ptr<PrototypeArg>> args,
@@ -41,6 +44,9 @@ public:
   void print(llvm::raw_fd_ostream &out, usize indent) {
     out.indent(indent) << "Prototype: '" << name
                        << "' (ret ty: " << returnType.getTypeName() << ")\n";
+    for (auto &annotation: annotations) {
+      annotation.print(out, indent + 1);
+    }
     for (auto &arg: args) {
       arg->print(out, indent + 1);
     }
@@ -62,6 +68,33 @@ public:
   }
   auto getReturnType() const -> Type { return returnType; }
   auto getLocation() const -> SourceLocation { return loc; }
+
+  auto setAnnotations(std::vector<Annotation> annotations) -> void {
+    this->annotations = annotations;
+  }
+  auto getAnnotations() const -> const std::vector<Annotation> & { return annotations; }
+  auto getAnnotation(const std::string &name) const -> const Annotation * {
+    for (auto &annotation: annotations) {
+      if (annotation.name == name) {
+        return &annotation;
+      }
+    }
+    return nullptr;
+  }
+  auto hasAnnotation(const std::string &name) const -> bool {
+    return getAnnotation(name) != nullptr;
+  }
+  auto isExported() const -> bool { return hasAnnotation("export"); }
+
+  // set for `extern` declarations, which are defined outside of Fern
+  auto setExtern(bool value) -> void { external = value; }
+  auto isExtern() const -> bool { return external; }
+
+  // whether the symbol is visible outside the module and follows the C calling
+  // convention. everything else is internal and fastcc
+  auto isExternallyVisible() const -> bool {
+    return external || isExported() || name == "main";
+  }
 };
 
 } // namespace fern
@@ -28,7 +28,11 @@ public:
 
   auto getOperand() const -> std::shared_ptr<AstNode> { return operand; }
   auto getIndex() const -> std::shared_ptr<AstNode> { return index; }
-  auto getIndexedType() const -> Type { return operand->getType().deref(); }
+  auto getIndexedType() const -> Type {
+    auto type = operand->getType();
+    // indexing a `str` gives its characters
+    return type.getReferenceDepth() > 0 ? type.deref() : Type::Char();
+  }
 };
 
 } // namespace fern
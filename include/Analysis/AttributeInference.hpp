@@ -0,0 +1,56 @@
+#ifndef Fern_Analysis_AttributeInference_hpp
+#define Fern_Analysis_AttributeInference_hpp
+
+#include <Roots/_defines.hpp>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CallGraph.hpp"
+
+namespace llvm {
+class Function;
+class CallInst;
+} // namespace llvm
+
+namespace fern {
+
+class AstNode;
+class ProgramNode;
+
+enum class MemoryEffect { None, Read, Write };
+
+struct FunctionEffects {
+  bool noUnwind = true;
+  bool willReturn = true;
+  MemoryEffect memory = MemoryEffect::None;
+  bool noAliasReturn = false;
+  std::vector<bool> noCaptureArgs;
+};
+
+// bottom-up inference of LLVM function attributes over the typed AST. externs are
+// assumed to read and write any memory, unwind, never return and capture all of
+// their arguments.
+class AttributeInference {
+public:
+  auto run(ProgramNode &program) -> void;
+
+  auto lookup(const std::string &name) const -> const FunctionEffects *;
+
+  auto apply(llvm::Function &func) const -> void;
+  auto apply(llvm::CallInst &call, const std::string &callee) const -> void;
+
+private:
+  auto conservativeEffects(usize arity) const -> FunctionEffects;
+  auto inferFunction(const CallGraph &graph, usize id, bool recursive) -> FunctionEffects;
+  auto captures(const std::shared_ptr<AstNode> &node, const std::string &param,
+                bool escapes) const -> bool;
+  auto tailNoAlias(const std::shared_ptr<AstNode> &node) const -> bool;
+  auto returnsNoAlias(const std::shared_ptr<AstNode> &body) const -> bool;
+
+  std::unordered_map<std::string, FunctionEffects> effects;
+};
+
+} // namespace fern
+
+#endif
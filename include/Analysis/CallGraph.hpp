@@ -0,0 +1,51 @@
+#ifndef Fern_Analysis_CallGraph_hpp
+#define Fern_Analysis_CallGraph_hpp
+
+#include <Roots/_defines.hpp>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fern {
+
+class ProgramNode;
+class Function;
+class ExternDef;
+
+// call graph over the top level items of a program, built from the `CallNode`s
+// found in each function body. externs are leaves.
+class CallGraph {
+public:
+  struct Node {
+    std::string name;
+    Function *func = nullptr;
+    ExternDef *ext = nullptr;
+    std::vector<usize> callees;
+
+    auto isExtern() const -> bool { return ext != nullptr; }
+  };
+
+  CallGraph(ProgramNode &program);
+
+  auto size() const -> usize { return nodes.size(); }
+  auto getNode(usize id) const -> const Node & { return nodes[id]; }
+  auto lookup(const std::string &name) const -> std::optional<usize>;
+
+  // strongly connected components, callees before callers
+  auto getSCCs() const -> std::vector<std::vector<usize>>;
+
+  // marks every node reachable from `roots`
+  auto getReachable(const std::vector<usize> &roots) const -> std::vector<bool>;
+
+  // whether `id` may call itself, directly or through other functions
+  auto isRecursive(usize id, const std::vector<usize> &scc) const -> bool;
+
+private:
+  std::vector<Node> nodes;
+  std::unordered_map<std::string, usize> nodeIds;
+};
+
+} // namespace fern
+
+#endif
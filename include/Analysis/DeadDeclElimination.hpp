@@ -0,0 +1,24 @@
+#ifndef Fern_Analysis_DeadDeclElimination_hpp
+#define Fern_Analysis_DeadDeclElimination_hpp
+
+#include <Roots/_defines.hpp>
+
+namespace fern {
+
+class ProgramNode;
+
+struct DeadDeclStats {
+  usize removedFunctions = 0;
+  usize removedExterns = 0;
+  usize removedNodes = 0;
+  usize keptNodes = 0;
+};
+
+// drops the functions and externs that can't be reached from `main` or an `@export`ed
+// function, before their bodies are type checked or lowered. programs with neither are
+// left untouched.
+auto eliminateDeadDecls(ProgramNode &program) -> DeadDeclStats;
+
+} // namespace fern
+
+#endif
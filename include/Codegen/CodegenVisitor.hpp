@@ -1,11 +1,16 @@
 #ifndef Fern_Codegen_CodegenVisitor_hpp
 #define Fern_Codegen_CodegenVisitor_hpp
 
+#include <Roots/_defines.hpp>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include "../AST/SymbolTable.hpp"
+#include "../Parse/SourceLocation.hpp"
 
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/Value.h"
 
 
@@ -14,6 +19,8 @@ namespace fern {
 class Type;
 
 class Context;
+class AttributeInference;
+class DebugInfo;
 
 class ProgramNode;
 
@@ -35,10 +42,49 @@ class BooleanNode;
 class NumberNode;
 class StringNode;
 
+enum class BranchHint : u8;
+
 class   CodegenVisitor {
 public:
   CodegenVisitor(Context &ctx) : ctx(ctx) {}
 
+  auto setAttributeInference(const AttributeInference *inference) -> void {
+    attrInference = inference;
+  }
+
+  // null leaves the module without debug metadata
+  auto setDebugInfo(DebugInfo *info) -> void { debugInfo = info; }
+
+  // `--fast` skips `verifyFunction` in builds of fern without asserts
+  auto setVerifyFunctions(bool verify) -> void { verifyFunctions = verify; }
+  auto shouldVerifyFunctions() const -> bool { return verifyFunctions; }
+
+  // pooled by content, so each distinct literal is emitted once per module. the
+  // globals are private `unnamed_addr` constants, which the backend places in
+  // mergeable string sections for the linker to deduplicate across objects
+  auto getStringLiteral(std::string_view value) -> llvm::Constant *;
+
+  // attached to every function defined in Fern as `target-cpu`/`target-features`, so
+  // the vectorizers and the backend see the selected CPU. empty leaves them unset
+  auto setTargetAttributes(std::string cpu, std::string features) -> void {
+    targetCPU = std::move(cpu);
+    targetFeatures = std::move(features);
+  }
+
+  // `--fast-math` turns it on for every function, `@fastmath` for one
+  auto setFastMath(bool enabled) -> void { fastMath = enabled; }
+
+  // sets up the builder's fast-math flags for the body of `func`, and the function
+  // attributes the backend needs to contract into FMAs. with debug info, opens the
+  // function's subprogram and starts it at the prototype's line
+  auto beginFunctionBody(llvm::Function &func, const Prototype &proto) -> void;
+  auto endFunctionBody() -> void;
+
+  // weighs the branch like `__builtin_expect` would, so block placement moves the
+  // unlikely side out of the hot path without a profile
+  auto createCondBr(llvm::Value *cond, llvm::BasicBlock *thenBlock, llvm::BasicBlock *elseBlock,
+                    BranchHint hint) -> llvm::BranchInst *;
+
   auto visit(ProgramNode &node) -> void;
   auto visit(Function &node) -> void;
   auto visit(ExternDef &node) -> void;
@@ -60,9 +106,29 @@ public:
   auto visit(StringNode &node) -> llvm::Value *;
 
 private:
+  // every local and parameter lives in a stack slot in the entry block. mem2reg and
+  // SROA turn them back into registers, and the lifetime markers let stack coloring
+  // share slots between scopes. neither runs at -O0, where every slot stays separate
+  auto createSlot(llvm::Type *type, const std::string &name) -> llvm::AllocaInst *;
+  auto startLifetime(llvm::AllocaInst *slot) -> void;
+  auto endScope() -> void;
+  auto isTerminated() -> bool;
+  auto emitFloatOp(BinaryNode &node, llvm::Value *lhs, llvm::Value *rhs) -> llvm::Value *;
+  // attaches `loc` to the instructions built from here on
+  auto emitLocation(SourceLocation loc) -> void;
+
   Context &ctx;
-  RawPtrSymbolTable<llvm::Value> varValueTable;
+  RawPtrSymbolTable<llvm::AllocaInst> varSlotTable;
+  // slots declared in each open block, ended when the block is left
+  std::vector<std::vector<llvm::AllocaInst *>> scopeSlots;
   llvm::Function *currentFunction = nullptr;
+  const AttributeInference *attrInference = nullptr;
+  DebugInfo *debugInfo = nullptr;
+  bool verifyFunctions = true;
+  bool fastMath = false;
+  std::string targetCPU;
+  std::string targetFeatures;
+  std::unordered_map<std::string, llvm::Constant *> stringPool;
 };
 
 } // namespace fern
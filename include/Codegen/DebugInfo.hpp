@@ -0,0 +1,72 @@
+#ifndef Fern_Codegen_DebugInfo_hpp
+#define Fern_Codegen_DebugInfo_hpp
+
+#include <Roots/_defines.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../Parse/SourceLocation.hpp"
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/IR/DebugLoc.h"
+
+namespace llvm {
+class AllocaInst;
+class BasicBlock;
+class Function;
+class Module;
+} // namespace llvm
+
+namespace fern {
+
+class Type;
+class Prototype;
+
+// `-g` describes functions, their locals and the types of both. `--gline-tables-only`
+// only maps code back to lines, which is enough for profilers and costs a fraction
+// of the size. `LocationsOnly` keeps the lines in the IR for `--remarks` without
+// emitting any DWARF
+enum class DebugInfoLevel { None, LocationsOnly, LineTablesOnly, Full };
+
+// builds the DWARF metadata for one module. codegen opens a subprogram per function
+// body and moves the builder's location along with the nodes it lowers.
+class DebugInfo {
+  llvm::Module &module;
+  DebugInfoLevel level;
+  bool optimized;
+  llvm::DIBuilder builder;
+  llvm::DICompileUnit *unit = nullptr;
+  llvm::DIFile *file = nullptr;
+  // the innermost lexical block of the current function last
+  std::vector<llvm::DIScope *> scopes;
+
+public:
+  DebugInfo(llvm::Module &module, std::string_view filename, DebugInfoLevel level,
+            bool optimized);
+
+  auto isFull() const -> bool { return level == DebugInfoLevel::Full; }
+
+  auto beginFunction(llvm::Function &func, const Prototype &proto) -> void;
+  auto endFunction() -> void;
+  auto beginScope(SourceLocation loc) -> void;
+  auto endScope() -> void;
+
+  // a location in the innermost open scope, empty outside of functions
+  auto getLocation(SourceLocation loc) -> llvm::DebugLoc;
+  // the same line and column as `loc`, moved into the innermost open scope
+  auto getLocation(const llvm::DebugLoc &loc) -> llvm::DebugLoc;
+
+  // only described with `-g`. `argNo` counts from 1 for parameters, 0 for lets
+  auto declareVariable(llvm::AllocaInst *slot, const std::string &name, const Type &type,
+                       SourceLocation loc, u32 argNo, llvm::BasicBlock *block) -> void;
+
+  // resolves forward references, has to run before the module is verified or emitted
+  auto finalize() -> void;
+
+private:
+  auto getType(const Type &type) -> llvm::DIType *;
+};
+
+} // namespace fern
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef Fern_Codegen_Emitter_hpp
+#define Fern_Codegen_Emitter_hpp
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+namespace llvm {
+class Module;
+class TargetMachine;
+class Triple;
+} // namespace llvm
+
+namespace fern {
+
+enum class EmitKind { IR, Bitcode, Assembly, Object, Executable };
+
+// `ll`, `bc`, `asm`, `obj` or `exe`
+auto parseEmitKind(std::string_view kind) -> std::optional<EmitKind>;
+
+// `dir/main.fern` becomes `main.o`, `main.s`, ... or just `main` for executables
+auto defaultOutputPath(std::string_view input, EmitKind kind) -> std::string;
+
+// whether executables for `target` are linked in-process by LLD. that needs fern to be
+// built with LLD, the target to be the host and `linkArgs` to hold nothing but objects
+// and linker flags. otherwise they go through the system C compiler driver
+auto linksInProcess(const llvm::Triple &target, const std::vector<std::string> &linkArgs = {})
+    -> bool;
+
+// writes `module` to `path`, `-` being stdout. executables are linked from the module's
+// object and `linkArgs`, which are `cc` arguments. LLD is handed the object in memory,
+// `cc` gets a temporary file
+auto emitModule(llvm::Module &module, llvm::TargetMachine &targetMachine, EmitKind kind,
+                const std::string &path, const std::vector<std::string> &linkArgs = {})
+    -> llvm::Error;
+
+// links `objects` into an executable for `target`, or into a single relocatable object
+// for `EmitKind::Object`. executables are linked with LLD when `linksInProcess` says
+// so, with `--gc-sections` and `--icf=safe`
+auto linkObjects(const std::vector<std::string> &objects, EmitKind kind,
+                 const std::string &path, const llvm::Triple &target) -> llvm::Error;
+
+#ifdef FERN_HAS_LLD
+// a file that only exists in memory, passed to LLD as `/proc/self/fd/<fd>` so objects
+// never touch the disk
+class MemoryFile {
+  int fd = -1;
+
+public:
+  MemoryFile() = default;
+  MemoryFile(const MemoryFile &) = delete;
+  MemoryFile(MemoryFile &&other) noexcept;
+  ~MemoryFile();
+
+  auto write(llvm::StringRef contents) -> llvm::Error;
+  auto getPath() const -> std::string;
+};
+#endif
+
+} // namespace fern
+
+#endif
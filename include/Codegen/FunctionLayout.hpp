@@ -0,0 +1,31 @@
+#ifndef Fern_Codegen_FunctionLayout_hpp
+#define Fern_Codegen_FunctionLayout_hpp
+
+#include <Roots/_defines.hpp>
+#include <string>
+#include <vector>
+#include "llvm/Support/Error.h"
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+namespace fern {
+
+struct HotFunction {
+  std::string name;
+  u64 entryCount;
+};
+
+// puts hot functions, from `@hot` or the profile, into `.text.hot` and cold ones into
+// `.text.unlikely`. the module is reordered hottest first, so hot code is contiguous
+// even without a linker ordering file. returns the hot functions in that order
+auto layoutFunctions(llvm::Module &module) -> std::vector<HotFunction>;
+
+// writes a `--symbol-ordering-file` for the linker, hottest first
+auto writeSymbolOrder(std::vector<HotFunction> functions, const std::string &path)
+    -> llvm::Error;
+
+} // namespace fern
+
+#endif
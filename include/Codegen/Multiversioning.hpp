@@ -0,0 +1,33 @@
+#ifndef Fern_Codegen_Multiversioning_hpp
+#define Fern_Codegen_Multiversioning_hpp
+
+#include <Roots/_defines.hpp>
+#include "llvm/Support/Error.h"
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+namespace fern {
+
+// how functions annotated `@target_clones(...)` pick their version
+enum class CloneDispatch {
+  // one clone per feature set behind an ifunc, resolved by the loader from CPUID.
+  // needs an x86 ELF target
+  IFunc,
+  // the best clone the compiling host supports, for the JIT
+  Host,
+  // only the default version, for targets without ifunc support
+  Default,
+};
+
+// set by codegen from `@target_clones(...)`, a comma separated list of features
+constexpr const char *targetClonesAttr = "fern-target-clones";
+
+// expands every function carrying `targetClonesAttr`, returning how many there were.
+// fails on features the x86 CPU dispatch doesn't know
+auto emitTargetClones(llvm::Module &module, CloneDispatch dispatch) -> llvm::Expected<usize>;
+
+} // namespace fern
+
+#endif
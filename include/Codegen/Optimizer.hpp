@@ -0,0 +1,50 @@
+#ifndef Fern_Codegen_Optimizer_hpp
+#define Fern_Codegen_Optimizer_hpp
+
+#include <string>
+#include "../Support/OptLevel.hpp"
+#include "llvm/Support/Error.h"
+
+namespace llvm {
+class Module;
+class TargetMachine;
+} // namespace llvm
+
+namespace fern {
+
+// `--profile-generate` instruments the default pipelines with InstrProf counters written
+// to `path` at exit, `--profile-use` feeds an indexed `.profdata` at `path` back in
+struct ProfileOptions {
+  enum class Mode { None, Generate, Use };
+
+  Mode mode = Mode::None;
+  std::string path;
+};
+
+// runs the standard new pass manager pipelines over a module. functions annotated
+// with `@optimize(level)` are kept out of the module pipeline and simplified on
+// their own at their level afterwards, or left untouched for `O0`.
+class Optimizer {
+  OptLevel level;
+  std::string pipeline;
+  llvm::TargetMachine *targetMachine;
+  ProfileOptions profile;
+  bool thinLTOPreLink = false;
+
+public:
+  Optimizer(OptLevel level, std::string pipeline = "",
+            llvm::TargetMachine *targetMachine = nullptr) :
+      level(level), pipeline(pipeline), targetMachine(targetMachine) {}
+
+  auto setProfile(ProfileOptions options) -> void { profile = std::move(options); }
+  // runs the ThinLTO pre-link pipelines instead, which leave inlining across units and
+  // the optimizations that would get in its way to the link
+  auto setThinLTOPreLink(bool enable) -> void { thinLTOPreLink = enable; }
+
+  // fails when a custom pipeline doesn't parse
+  auto run(llvm::Module &module) -> llvm::Error;
+};
+
+} // namespace fern
+
+#endif
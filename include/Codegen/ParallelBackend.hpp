@@ -0,0 +1,63 @@
+#ifndef Fern_Codegen_ParallelBackend_hpp
+#define Fern_Codegen_ParallelBackend_hpp
+
+#include <Roots/_defines.hpp>
+#include <string>
+#include <vector>
+#include "../Support/OptLevel.hpp"
+#include "Emitter.hpp"
+#include "Optimizer.hpp"
+#include "llvm/Support/Error.h"
+
+namespace llvm {
+class Module;
+class TargetMachine;
+} // namespace llvm
+
+namespace fern {
+
+class RemarkCollector;
+
+// optimizes and compiles `module` as `jobs` partitions at once. functions are spread
+// over the partitions by size, each partition is reparsed into its own context and
+// gets its own target machine, and small functions it calls from other partitions
+// are copied in as `available_externally` so they can still be inlined. the
+// objects are combined in partition order, so the output doesn't depend on which
+// thread finishes first.
+class ParallelBackend {
+  OptLevel level;
+  std::string pipeline;
+  llvm::TargetMachine &targetMachine;
+  u32 jobs;
+  ProfileOptions profile;
+  std::vector<std::string> linkArgs;
+  std::string symbolOrder;
+  RemarkCollector *remarks = nullptr;
+
+public:
+  ParallelBackend(OptLevel level, std::string pipeline, llvm::TargetMachine &targetMachine,
+                  u32 jobs) :
+      level(level), pipeline(std::move(pipeline)), targetMachine(targetMachine), jobs(jobs) {}
+
+  auto setProfile(ProfileOptions options) -> void { profile = std::move(options); }
+  // extra `cc` arguments when linking executables, after the partitions
+  auto setLinkArgs(std::vector<std::string> args) -> void { linkArgs = std::move(args); }
+  // the hot functions of all partitions are written here before linking
+  auto setSymbolOrder(std::string path) -> void { symbolOrder = std::move(path); }
+  // installed on every partition's context
+  auto setRemarks(RemarkCollector *collector) -> void { remarks = collector; }
+
+  // only objects and executables can be put back together, everything else has to
+  // go through the serial path
+  static auto supports(EmitKind kind) -> bool {
+    return kind == EmitKind::Object || kind == EmitKind::Executable;
+  }
+
+  // `module` is left with its local functions externalized and should not be
+  // used afterwards
+  auto run(llvm::Module &module, EmitKind kind, const std::string &path) -> llvm::Error;
+};
+
+} // namespace fern
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef Fern_Codegen_ProfileRuntime_hpp
+#define Fern_Codegen_ProfileRuntime_hpp
+
+#include <string>
+#include "llvm/Support/Error.h"
+
+namespace fern {
+
+// writes the C source of the runtime `--profile-generate` executables are linked
+// with to a temporary file and returns its path. it dumps the InstrProf counters to
+// `$LLVM_PROFILE_FILE`, the path given at compile time or `default.profraw` at exit.
+// there's no value profiling and no `%p`/`%m` expansion in file names
+auto writeProfileRuntime() -> llvm::Expected<std::string>;
+
+} // namespace fern
+
+#endif
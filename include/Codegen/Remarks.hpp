@@ -0,0 +1,79 @@
+#ifndef Fern_Codegen_Remarks_hpp
+#define Fern_Codegen_Remarks_hpp
+
+#include <Roots/_defines.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../Parse/SourceLocation.hpp"
+#include "llvm/Remarks/RemarkFormat.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Regex.h"
+
+namespace llvm {
+class DiagnosticInfoOptimizationBase;
+class LLVMContext;
+} // namespace llvm
+
+namespace fern {
+
+class FancyErrorPrinter;
+
+enum class RemarkKind { Passed, Missed, Analysis };
+
+auto parseRemarkKind(std::string_view kind) -> std::optional<RemarkKind>;
+
+// collects the optimization remarks LLVM emits for `--remarks`. it can be installed
+// on any number of contexts, e.g. one per parallel partition, and is safe to feed
+// from several threads. remarks only point at Fern source if the module carries
+// debug locations
+class RemarkCollector {
+  struct Record {
+    RemarkKind kind;
+    std::string pass;
+    std::string name;
+    std::string function;
+    std::string message;
+    std::string file;
+    std::optional<SourceLocation> loc;
+    std::optional<u64> hotness;
+    std::vector<std::pair<std::string, std::string>> args;
+  };
+
+  std::vector<RemarkKind> kinds;
+  std::optional<llvm::Regex> filter;
+  bool hotness = false;
+  std::mutex mutex;
+  std::vector<Record> records;
+
+  RemarkCollector(std::vector<RemarkKind> kinds, std::optional<llvm::Regex> filter) :
+      kinds(std::move(kinds)), filter(std::move(filter)) {}
+
+public:
+  // `filter` is a regex on pass names, empty for every pass
+  static auto create(std::vector<RemarkKind> kinds, const std::string &filter)
+      -> llvm::Expected<std::unique_ptr<RemarkCollector>>;
+
+  // with a profile, remarks say how often the code they're about ran
+  auto setHotness(bool enabled) -> void { hotness = enabled; }
+
+  auto isEnabled(RemarkKind kind, llvm::StringRef pass) const -> bool;
+  auto install(llvm::LLVMContext &llvmCtx) -> void;
+  auto add(const llvm::DiagnosticInfoOptimizationBase &remark) -> void;
+
+  auto size() const -> usize { return records.size(); }
+
+  // in source order, remarks without a location last
+  auto print(const FancyErrorPrinter &printer) -> void;
+  auto serialize(const std::string &path, llvm::remarks::Format format) -> llvm::Error;
+
+private:
+  auto sort() -> void;
+};
+
+} // namespace fern
+
+#endif
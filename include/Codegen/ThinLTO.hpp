@@ -0,0 +1,55 @@
+#ifndef Fern_Codegen_ThinLTO_hpp
+#define Fern_Codegen_ThinLTO_hpp
+
+#include <Roots/_defines.hpp>
+#include <string>
+#include <vector>
+#include "../Support/OptLevel.hpp"
+#include "llvm/Support/Error.h"
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+namespace fern {
+
+// writes `module` as bitcode with a ThinLTO module summary attached. the module should
+// have been through the ThinLTO pre-link pipeline, see `Optimizer::setThinLTOPreLink`
+auto writeThinLTOBitcode(llvm::Module &module, const std::string &path) -> llvm::Error;
+
+// links the units written by `--lto=thin` into an executable. their summaries are
+// combined to decide which functions get imported where, then every unit is
+// optimized and compiled on its own thread with the imports it needs. inputs that
+// aren't bitcode, like objects and `cc` arguments, are passed on to the final link.
+// compiled units are cached by a hash of their IR, their imports and the options,
+// so relinking after an edit only recompiles the units it affects.
+class ThinLTOLinker {
+  OptLevel level;
+  u32 jobs;
+  std::string cacheDir;
+  u64 cacheSize = 0;
+  usize units = 0;
+  usize cacheHits = 0;
+
+public:
+  ThinLTOLinker(OptLevel level, u32 jobs) : level(level), jobs(jobs) {}
+
+  // `<prefix>/cache/thinlto`, next to the JIT's object cache
+  static auto defaultCacheDirectory() -> std::string;
+
+  // no cache is used until this is called. the directory is pruned to `maxBytes`
+  // after every link
+  auto setCache(std::string dir, u64 maxBytes) -> void {
+    cacheDir = std::move(dir);
+    cacheSize = maxBytes;
+  }
+
+  auto run(const std::vector<std::string> &inputs, const std::string &path) -> llvm::Error;
+
+  auto getUnits() const -> usize { return units; }
+  auto getCacheHits() const -> usize { return cacheHits; }
+};
+
+} // namespace fern
+
+#endif
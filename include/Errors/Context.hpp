@@ -1,17 +1,22 @@
 #ifndef Fern_Parse_ParseContext_hpp
 #define Fern_Parse_ParseContext_hpp
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "../AST/ExternDef.hpp"
 #include "../AST/Function.hpp"
+#include "../Support/Statistics.hpp"
+#include "../Support/TargetSpec.hpp"
 #include "Error.hpp"
 #include "FancyPrinter.hpp"
 
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Target/TargetMachine.h"
 
 namespace fern {
 
@@ -20,10 +25,14 @@ class Context {
   std::vector<Error> warnings;
   std::string_view source;
   std::string_view filename;
+  Statistics stats;
+  TargetSpec targetSpec;
 
-  llvm::LLVMContext llvmContext;
-  llvm::IRBuilder<> builder{llvmContext};
-  llvm::Module llvmModule{"main", llvmContext};
+  // created on first use, so runs that stop before codegen never allocate them
+  std::unique_ptr<llvm::LLVMContext> llvmContext;
+  std::unique_ptr<llvm::IRBuilder<>> builder;
+  std::unique_ptr<llvm::Module> llvmModule;
+  std::unique_ptr<llvm::TargetMachine> targetMachine;
 
 public:
   Context(std::string_view source, std::string_view filename) :
@@ -63,10 +72,37 @@ public:
   auto getSource() const -> std::string_view { return source; }
   auto getFilename() const -> std::string_view { return filename; }
   auto getErrors() const -> const std::vector<Error> & { return errors; }
+  auto getStats() -> Statistics & { return stats; }
 
-  auto getLLVMContext() -> llvm::LLVMContext & { return llvmContext; }
-  auto getBuilder() -> llvm::IRBuilder<> & { return builder; }
-  auto getModule() -> llvm::Module & { return llvmModule; }
+  auto initLLVM() -> void;
+  auto hasLLVM() const -> bool { return llvmContext != nullptr; }
+
+  auto getLLVMContext() -> llvm::LLVMContext & {
+    initLLVM();
+    return *llvmContext;
+  }
+  auto getBuilder() -> llvm::IRBuilder<> & {
+    initLLVM();
+    return *builder;
+  }
+  auto getModule() -> llvm::Module & {
+    initLLVM();
+    return *llvmModule;
+  }
+
+  // hands the module and the context owning it over, e.g. to the JIT. the builder
+  // is dropped with them
+  auto takeLLVM() -> std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>> {
+    builder.reset();
+    return {std::move(llvmContext), std::move(llvmModule)};
+  }
+
+  // has to be set before the target machine is first requested
+  auto setTargetSpec(TargetSpec spec) -> void { targetSpec = std::move(spec); }
+  auto getTargetSpec() const -> const TargetSpec & { return targetSpec; }
+
+  // target machine for the target spec, created once and reused for every emission
+  auto getTargetMachine() -> llvm::Expected<llvm::TargetMachine &>;
 };
 
 } // namespace fern
@@ -6,15 +6,21 @@
 
 namespace fern {
 
+// remarks report what the optimizer did, they never fail a compilation
+enum class Severity { Error, Warning, Remark };
+
 class Error {
   std::string message_;
   std::string note_;
   SourceLocation location_;
-  bool isWarning_;
+  Severity severity_;
 
 public:
   Error(const std::string &message, const SourceLocation &location, bool isWarning = false)
-      : message_(message), note_(), location_(location), isWarning_(isWarning) {}
+      : message_(message), note_(), location_(location),
+        severity_(isWarning ? Severity::Warning : Severity::Error) {}
+  Error(const std::string &message, const SourceLocation &location, Severity severity)
+      : message_(message), note_(), location_(location), severity_(severity) {}
   ~Error() = default;
 
   auto addNote(const std::string &note) -> void { note_ = note; }
@@ -22,10 +28,26 @@ public:
   auto getMessage() const -> std::string { return message_; }
   auto getNote() const -> std::string { return note_; }
   auto getLocation() const -> SourceLocation { return location_; }
-  auto isWarning() const -> bool { return isWarning_; }
+  auto isWarning() const -> bool { return severity_ == Severity::Warning; }
+  auto getSeverity() const -> Severity { return severity_; }
+
+  auto getSeverityName() const -> const char * {
+    switch (severity_) {
+    case Severity::Error:
+      return "error";
+    case Severity::Warning:
+      return "warning";
+    case Severity::Remark:
+      return "remark";
+    }
+    return "error";
+  }
 
   auto toString() const -> std::string {
-    return location_.toString() + (isWarning_ ? " warn" : " err") + ": " + message_;
+    auto severity = severity_ == Severity::Error     ? " err"
+                    : severity_ == Severity::Warning ? " warn"
+                                                     : " remark";
+    return location_.toString() + severity + ": " + message_;
   }
 };
 
@@ -31,7 +31,7 @@ public:
     auto col = loc.getColumn();
 
     std::cerr << fmt::format("{}:{}:{}: {}: {}\n", filename, line + 1, col + 1,
-                             error.isWarning() ? "warning" : "error", error.getMessage());
+                             error.getSeverityName(), error.getMessage());
     std::cerr << fmt::format("{} |\n",
                              std::string(std::to_string(line + 1).length(), ' '));
     std::cerr << fmt::format("{} | {}", line + 1, getSourceLine(line)) << std::endl;
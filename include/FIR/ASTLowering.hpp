@@ -0,0 +1,19 @@
+#ifndef Fern_FIR_ASTLowering_hpp
+#define Fern_FIR_ASTLowering_hpp
+
+#include "FIR.hpp"
+
+namespace fern {
+
+class Context;
+class ProgramNode;
+
+namespace fir {
+
+// lowers a type checked program into FIR, turning locals into SSA values
+auto lowerProgram(ProgramNode &program, Context &ctx) -> Module;
+
+} // namespace fir
+} // namespace fern
+
+#endif
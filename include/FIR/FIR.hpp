@@ -0,0 +1,155 @@
+#ifndef Fern_FIR_FIR_hpp
+#define Fern_FIR_FIR_hpp
+
+#include <Roots/_defines.hpp>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Sema/Type.hpp"
+#include "llvm/Support/raw_ostream.h"
+
+namespace fern {
+
+class Prototype;
+
+// Fern's mid-level IR. each function is in SSA form and keeps its instructions and
+// their operands in flat arrays; blocks only hold the ids of their instructions.
+namespace fir {
+
+using ValueId = u32;
+using BlockId = u32;
+using FuncId = u32;
+
+enum class Opcode : u8 {
+  Nop, // erased instruction
+
+  ConstInt,
+  ConstFloat,
+  ConstBool,
+  ConstStr, // imm is the index into the module string table
+  Param,    // imm is the parameter index
+
+  Add,
+  Sub,
+  Mul,
+  SDiv,
+  FAdd,
+  FSub,
+  FMul,
+  FDiv,
+  Neg,
+  FNeg,
+  Not,
+  SIToFP,
+
+  ICmpEQ,
+  ICmpNE,
+  ICmpSLT,
+  ICmpSLE,
+  ICmpSGT,
+  ICmpSGE,
+  FCmpOEQ,
+  FCmpUNE,
+  FCmpOLT,
+  FCmpOLE,
+  FCmpOGT,
+  FCmpOGE,
+
+  Index, // operands: base, index. imm is 1 once the access is proven in bounds
+
+  Call, // operands: args. imm is the callee id
+  Phi,  // operands: (value, block) pairs
+  Copy,
+
+  Br,     // operands: target
+  CondBr, // operands: cond, then, else. imm is 1 if then is likely, -1 if unlikely
+  Ret,    // operands: value, or none for void
+  Unreachable,
+};
+
+auto opcodeName(Opcode op) -> const char *;
+auto isTerminator(Opcode op) -> bool;
+auto hasSideEffects(Opcode op) -> bool;
+
+struct Inst {
+  Opcode op = Opcode::Nop;
+  Type type = Type::Void();
+  BlockId block = 0;
+  u32 firstOperand = 0;
+  u32 numOperands = 0;
+  i64 imm = 0;
+  double fimm = 0;
+};
+
+struct Block {
+  std::vector<ValueId> insts; // phis first, terminator last
+};
+
+class Function {
+public:
+  std::string name;
+  std::vector<Type> paramTypes;
+  Type returnType = Type::Void();
+  std::shared_ptr<Prototype> proto;
+  bool isExtern = false;
+
+  std::vector<Inst> insts;
+  std::vector<u32> operands;
+  std::vector<Block> blocks;
+
+  // filled in by the escape analysis
+  std::vector<bool> noCaptureParams;
+
+  auto addBlock() -> BlockId;
+  auto append(BlockId block, Opcode op, Type type, const std::vector<u32> &ops = {},
+              i64 imm = 0) -> ValueId;
+  // creates an instruction that isn't placed in any block yet
+  auto create(Opcode op, Type type, const std::vector<u32> &ops = {}, i64 imm = 0) -> ValueId;
+
+  auto getOperands(ValueId id) -> std::span<u32> {
+    return {operands.data() + insts[id].firstOperand, insts[id].numOperands};
+  }
+  auto isValueOperand(ValueId id, u32 index) const -> bool;
+
+  auto erase(ValueId id) -> void;
+  auto replaceAllUses(ValueId from, ValueId to) -> void;
+  // rewrites every use through `replacement`, following chains. values that map to
+  // themselves are left alone
+  auto replaceUses(const std::vector<ValueId> &replacement) -> void;
+  auto countUses() const -> std::vector<u32>;
+
+  auto getTerminator(BlockId block) const -> const Inst *;
+  auto successors(BlockId block) -> std::vector<BlockId>;
+  auto predecessors() -> std::vector<std::vector<BlockId>>;
+  // blocks reachable from the entry, in reverse post-order
+  auto reversePostOrder() -> std::vector<BlockId>;
+  // immediate dominator of each block, the entry block dominates itself
+  auto dominators() -> std::vector<BlockId>;
+
+  auto liveInstCount() const -> usize;
+};
+
+class Module {
+public:
+  std::vector<Function> functions;
+  std::vector<std::string> strings;
+
+  auto addFunction(Function func) -> FuncId;
+  auto lookup(const std::string &name) const -> const Function *;
+  auto lookupId(const std::string &name) const -> std::optional<FuncId>;
+  auto internString(const std::string &value) -> u32;
+
+  auto print(llvm::raw_ostream &out) -> void;
+
+private:
+  std::unordered_map<std::string, FuncId> functionIds;
+  std::unordered_map<std::string, u32> stringIds;
+};
+
+} // namespace fir
+} // namespace fern
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef Fern_FIR_LLVMLowering_hpp
+#define Fern_FIR_LLVMLowering_hpp
+
+#include "FIR.hpp"
+
+namespace fern {
+
+class Context;
+class CodegenVisitor;
+class AttributeInference;
+
+namespace fir {
+
+// emits the module into `ctx.getModule()`. declarations go through the codegen
+// visitor so both paths produce the same signatures and attributes.
+auto lowerToLLVM(Module &module, Context &ctx, CodegenVisitor &codegen,
+                 const AttributeInference *attrs) -> void;
+
+} // namespace fir
+} // namespace fern
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef Fern_FIR_Passes_hpp
+#define Fern_FIR_Passes_hpp
+
+#include <Roots/_defines.hpp>
+#include <memory>
+#include <vector>
+#include "FIR.hpp"
+
+namespace fern {
+
+class AttributeInference;
+class Statistics;
+
+namespace fir {
+
+class Pass {
+public:
+  virtual ~Pass() = default;
+
+  virtual auto getName() const -> const char * = 0;
+  // returns whether the module changed
+  virtual auto run(Module &module) -> bool = 0;
+};
+
+class PassManager {
+  std::vector<std::unique_ptr<Pass>> passes;
+  Statistics *stats;
+
+public:
+  PassManager(Statistics *stats = nullptr) : stats(stats) {}
+
+  auto add(std::unique_ptr<Pass> pass) -> void { passes.push_back(std::move(pass)); }
+  auto run(Module &module) -> void;
+
+  // the pipeline used by `--fir`
+  static auto buildDefaultPipeline(const AttributeInference *attrs, Statistics *stats)
+      -> PassManager;
+};
+
+// forwards copies and phis with a single incoming value to their source
+auto createCopyPropagationPass() -> std::unique_ptr<Pass>;
+// dominator scoped value numbering of pure instructions, including calls to Fern
+// functions inferred to be readnone
+auto createGVNPass(const AttributeInference *attrs) -> std::unique_ptr<Pass>;
+// inlines non-recursive Fern functions with at most `threshold` instructions
+auto createInlinerPass(usize threshold) -> std::unique_ptr<Pass>;
+// folds constant indexes into string literals and marks accesses proven in bounds
+auto createBoundsPass() -> std::unique_ptr<Pass>;
+// marks pointer parameters that never outlive a call as nocapture
+auto createEscapeAnalysisPass() -> std::unique_ptr<Pass>;
+// merges blocks into their only predecessor when it unconditionally branches to them
+auto createMergeBlocksPass() -> std::unique_ptr<Pass>;
+auto createDeadCodeEliminationPass(const AttributeInference *attrs) -> std::unique_ptr<Pass>;
+
+} // namespace fir
+} // namespace fern
+
+#endif
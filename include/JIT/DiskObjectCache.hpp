@@ -0,0 +1,66 @@
+#ifndef Fern_JIT_DiskObjectCache_hpp
+#define Fern_JIT_DiskObjectCache_hpp
+
+#include <Roots/_defines.hpp>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include "../Support/OptLevel.hpp"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace fern {
+
+// object files compiled by the JIT, stored under `<prefix>/cache` as `<key>.o`. the key
+// hashes the unoptimized module, the target and the optimization level, and is
+// attached to the module before it is optimized, so a hit skips optimization as
+// well as codegen. a hit is loaded right away and kept until the compiler asks for
+// it, so pruning can't turn it into a miss in between. entries are written with an
+// atomic rename, and the least recently used ones are evicted once the directory
+// grows past its size limit.
+class DiskObjectCache : public llvm::ObjectCache {
+  std::string dir;
+  u64 maxBytes;
+  std::atomic<usize> hits = 0;
+  std::atomic<usize> misses = 0;
+  std::atomic<usize> evictions = 0;
+
+  // objects found by `load`, waiting to be handed over by `getObject`
+  std::mutex loadedMutex;
+  std::multimap<std::string, std::unique_ptr<llvm::MemoryBuffer>> loaded;
+
+  auto pathFor(llvm::StringRef key) const -> std::string;
+  static auto getKey(const llvm::Module &module) -> llvm::StringRef;
+
+public:
+  DiskObjectCache(std::string dir, u64 maxBytes) : dir(std::move(dir)), maxBytes(maxBytes) {}
+
+  // `$FERN_PREFIX_DIR/cache`, falling back to the prefix fern was configured with
+  static auto defaultDirectory() -> std::string;
+
+  // hashes `module` as it is now and attaches the key to it
+  static auto tagModule(llvm::Module &module, llvm::StringRef target, OptLevel level)
+      -> std::string;
+
+  // reads the object stored under `key`, if any, and holds on to it for the module's
+  // `getObject`. returns whether it was found
+  auto load(llvm::StringRef key) -> bool;
+
+  auto notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object)
+      -> void override;
+  auto getObject(const llvm::Module *module) -> std::unique_ptr<llvm::MemoryBuffer> override;
+
+  // evicts the least recently used entries until the cache fits its size limit. objects
+  // still being written are left alone
+  auto prune() -> void;
+
+  auto getHits() const -> usize { return hits; }
+  auto getMisses() const -> usize { return misses; }
+  auto getEvictions() const -> usize { return evictions; }
+};
+
+} // namespace fern
+
+#endif
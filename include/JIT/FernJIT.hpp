@@ -0,0 +1,51 @@
+#ifndef Fern_JIT_FernJIT_hpp
+#define Fern_JIT_FernJIT_hpp
+
+#include <Roots/_defines.hpp>
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "../Support/OptLevel.hpp"
+#include "DiskObjectCache.hpp"
+#include "JITEngine.hpp"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+
+namespace fern {
+
+// in-process lazy JIT used by `fern run`. functions are only optimized and compiled
+// the first time they're called, and externs resolve against the host process.
+// with a cache, partitions compiled by earlier runs are loaded from disk instead.
+class FernJIT : public JITEngine {
+  // declared first so it outlives the compiler holding on to it
+  std::unique_ptr<DiskObjectCache> cache;
+  std::unique_ptr<llvm::orc::LLLazyJIT> jit;
+  std::atomic<usize> compiledPartitions = 0;
+
+  // sources of the modules added by fern. the JIT's own support code bakes in
+  // addresses from this process, so only these are cached
+  std::set<std::string> cacheableSources;
+
+  FernJIT(std::unique_ptr<llvm::orc::LLLazyJIT> jit, std::unique_ptr<DiskObjectCache> cache,
+          OptLevel level, std::string target);
+
+public:
+  // `perfMap` makes the compiled code visible to `perf`, see `createPerfLinkingLayer`
+  static auto create(OptLevel level, std::unique_ptr<DiskObjectCache> cache = nullptr,
+                     bool perfMap = false) -> llvm::Expected<std::unique_ptr<FernJIT>>;
+
+  auto getDataLayout() const -> const llvm::DataLayout & override {
+    return jit->getDataLayout();
+  }
+
+  auto addModule(std::unique_ptr<llvm::LLVMContext> context,
+                 std::unique_ptr<llvm::Module> module) -> llvm::Error override;
+  auto runMain(const std::string &programName, const std::vector<std::string> &args,
+               bool returnsVoid) -> llvm::Expected<int> override;
+  auto printStats(std::ostream &out) const -> void override;
+};
+
+} // namespace fern
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef Fern_JIT_JITEngine_hpp
+#define Fern_JIT_JITEngine_hpp
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+
+namespace fern {
+
+// what `fern run` needs from a JIT
+class JITEngine {
+public:
+  virtual ~JITEngine() = default;
+
+  virtual auto getDataLayout() const -> const llvm::DataLayout & = 0;
+
+  virtual auto addModule(std::unique_ptr<llvm::LLVMContext> context,
+                         std::unique_ptr<llvm::Module> module) -> llvm::Error = 0;
+
+  // calls `main` like a C runtime would, `args` not including the program name
+  virtual auto runMain(const std::string &programName, const std::vector<std::string> &args,
+                       bool returnsVoid) -> llvm::Expected<int> = 0;
+
+  // printed by `--jit-stats`
+  virtual auto printStats(std::ostream &out) const -> void = 0;
+};
+
+} // namespace fern
+
+#endif
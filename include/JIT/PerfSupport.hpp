@@ -0,0 +1,15 @@
+#ifndef Fern_JIT_PerfSupport_hpp
+#define Fern_JIT_PerfSupport_hpp
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+
+namespace fern {
+
+// object linking layer for `--perf-map`. every object the JIT loads has its functions
+// appended to `/tmp/perf-<pid>.map` for `perf report`, and written as jitdump records,
+// line tables included when the module has debug info, for `perf inject --jit`
+auto createPerfLinkingLayer() -> llvm::orc::LLJITBuilderState::ObjectLinkingLayerCreator;
+
+} // namespace fern
+
+#endif
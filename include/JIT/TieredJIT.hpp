@@ -0,0 +1,76 @@
+#ifndef Fern_JIT_TieredJIT_hpp
+#define Fern_JIT_TieredJIT_hpp
+
+#include <Roots/_defines.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "../Support/OptLevel.hpp"
+#include "JITEngine.hpp"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+
+namespace fern {
+
+// JIT for `fern run --tiered`. every function is compiled up front as optnone with
+// an entry counter and called through a stub. once a counter reaches the threshold,
+// a background thread recompiles the function at the tier-up level, with the rest
+// of the module available for inlining, and points its stub at the new body.
+class TieredJIT : public JITEngine {
+  struct TierUp {
+    std::string name;
+    double compileMs;
+  };
+
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+  std::unique_ptr<llvm::orc::IndirectStubsManager> stubs;
+  OptLevel tierUpLevel;
+  u64 threshold;
+
+  // the unoptimized module, reparsed into a fresh context for every recompile
+  llvm::SmallVector<char, 0> bitcode;
+  std::vector<std::string> functions;
+
+  std::thread worker;
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<u32> queue;
+  bool stopping = false;
+
+  std::vector<TierUp> tierUps;
+  std::vector<std::string> failures;
+
+  TieredJIT(std::unique_ptr<llvm::orc::LLJIT> jit,
+            std::unique_ptr<llvm::orc::IndirectStubsManager> stubs, OptLevel tierUpLevel,
+            u64 threshold);
+
+  auto instrument(llvm::Module &module) -> void;
+  auto workerLoop() -> void;
+  auto recompile(u32 id) -> llvm::Error;
+
+public:
+  ~TieredJIT() override;
+
+  // `perfMap` makes both tiers visible to `perf`, see `createPerfLinkingLayer`
+  static auto create(OptLevel tierUpLevel, u64 threshold, bool perfMap = false)
+      -> llvm::Expected<std::unique_ptr<TieredJIT>>;
+
+  auto getDataLayout() const -> const llvm::DataLayout & override {
+    return jit->getDataLayout();
+  }
+
+  auto addModule(std::unique_ptr<llvm::LLVMContext> context,
+                 std::unique_ptr<llvm::Module> module) -> llvm::Error override;
+  auto runMain(const std::string &programName, const std::vector<std::string> &args,
+               bool returnsVoid) -> llvm::Expected<int> override;
+  auto printStats(std::ostream &out) const -> void override;
+
+  // called from generated code when a counter reaches the threshold
+  auto requestTierUp(u32 id) -> void;
+};
+
+} // namespace fern
+
+#endif
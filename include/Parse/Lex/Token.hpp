@@ -19,6 +19,7 @@ enum class TokenKind {
   Colon,
   Semicolon,
   Ref,
+  At,
   
   // Operators
   Plus,
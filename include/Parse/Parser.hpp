@@ -69,6 +69,7 @@ private:
     return it->second;
   }
 
+  auto parseAnnotations() -> std::optional<std::vector<Annotation>>;
   auto parseFunctionPrototype() -> std::shared_ptr<Prototype>;
   auto parseFunction() -> std::shared_ptr<Function>;
   auto parseExternDef() -> std::shared_ptr<ExternDef>;
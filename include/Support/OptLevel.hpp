@@ -0,0 +1,53 @@
+#ifndef Fern_Support_OptLevel_hpp
+#define Fern_Support_OptLevel_hpp
+
+#include <optional>
+#include <string_view>
+
+namespace fern {
+
+enum class OptLevel { O0, O1, O2, O3, Os, Oz };
+
+// accepts the part after `-O`, with or without the `O`, so `2`, `O2` and `s` all parse
+inline auto parseOptLevel(std::string_view level) -> std::optional<OptLevel> {
+  if (level.size() == 2 && level[0] == 'O') {
+    level.remove_prefix(1);
+  }
+
+  if (level == "0") {
+    return OptLevel::O0;
+  } else if (level == "1") {
+    return OptLevel::O1;
+  } else if (level == "2") {
+    return OptLevel::O2;
+  } else if (level == "3") {
+    return OptLevel::O3;
+  } else if (level == "s") {
+    return OptLevel::Os;
+  } else if (level == "z") {
+    return OptLevel::Oz;
+  }
+  return std::nullopt;
+}
+
+inline auto optLevelName(OptLevel level) -> const char * {
+  switch (level) {
+  case OptLevel::O0:
+    return "O0";
+  case OptLevel::O1:
+    return "O1";
+  case OptLevel::O2:
+    return "O2";
+  case OptLevel::O3:
+    return "O3";
+  case OptLevel::Os:
+    return "Os";
+  case OptLevel::Oz:
+    return "Oz";
+  }
+  return "O0";
+}
+
+} // namespace fern
+
+#endif
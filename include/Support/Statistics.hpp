@@ -0,0 +1,90 @@
+#ifndef Fern_Support_Statistics_hpp
+#define Fern_Support_Statistics_hpp
+
+#include <Roots/_defines.hpp>
+#include <fmt/format.h>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fern {
+
+// timings and counters collected over a compilation, printed by `--stats`
+class Statistics {
+  std::vector<std::pair<std::string, double>> timings; // milliseconds
+  std::vector<std::pair<std::string, usize>> counters;
+
+public:
+  class Timer {
+    Statistics &stats;
+    std::string name;
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    Timer(Statistics &stats, std::string name) :
+        stats(stats), name(name), start(std::chrono::steady_clock::now()) {}
+    Timer(const Timer &) = delete;
+    ~Timer() {
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+      stats.addTiming(name, elapsed.count());
+    }
+  };
+
+  // records the time until the returned timer goes out of scope
+  auto time(const std::string &name) -> Timer { return Timer(*this, name); }
+
+  auto addTiming(const std::string &name, double ms) -> void {
+    for (auto &[timingName, total]: timings) {
+      if (timingName == name) {
+        total += ms;
+        return;
+      }
+    }
+    timings.emplace_back(name, ms);
+  }
+
+  auto addCounter(const std::string &name, usize value) -> void {
+    for (auto &[counterName, total]: counters) {
+      if (counterName == name) {
+        total += value;
+        return;
+      }
+    }
+    counters.emplace_back(name, value);
+  }
+
+  auto getTiming(const std::string &name) const -> double {
+    for (auto &[timingName, total]: timings) {
+      if (timingName == name) {
+        return total;
+      }
+    }
+    return 0;
+  }
+
+  auto getCounter(const std::string &name) const -> usize {
+    for (auto &[counterName, total]: counters) {
+      if (counterName == name) {
+        return total;
+      }
+    }
+    return 0;
+  }
+
+  auto print(std::ostream &out) const -> void {
+    out << "Statistics:\n";
+    for (auto &[name, ms]: timings) {
+      out << fmt::format("  {:<32} {:>10.3f} ms\n", name, ms);
+    }
+    for (auto &[name, value]: counters) {
+      out << fmt::format("  {:<32} {:>10}\n", name, value);
+    }
+  }
+};
+
+} // namespace fern
+
+#endif
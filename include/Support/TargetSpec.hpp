@@ -0,0 +1,26 @@
+#ifndef Fern_Support_TargetSpec_hpp
+#define Fern_Support_TargetSpec_hpp
+
+#include <string>
+#include <string_view>
+
+namespace fern {
+
+// the machine code is generated for, from `--target`, `--march`, `--mcpu` and `--mattr`.
+// the defaults are the host triple with a generic baseline CPU, so binaries run anywhere
+// the triple does
+struct TargetSpec {
+  std::string triple; // empty for the host
+  std::string cpu = "generic";
+  std::string features; // comma separated, e.g. `+avx2,-avx512f`
+
+  // `native` picks the host CPU and every feature it has, anything else is a CPU name
+  auto setArch(std::string_view arch) -> void;
+  auto addFeatures(std::string_view attrs) -> void;
+
+  auto isDefaultCPU() const -> bool { return cpu == "generic" && features.empty(); }
+};
+
+} // namespace fern
+
+#endif
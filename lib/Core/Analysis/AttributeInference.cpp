@@ -0,0 +1,288 @@
+#include "Analysis/AttributeInference.hpp"
+#include <algorithm>
+#include "AST/AstWalk.hpp"
+#include "AST/Nodes.hpp"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+namespace fern {
+
+static auto isPointerType(const Type &type) -> bool {
+  return type.getKind() == TypeKind::Str || type.getReferenceDepth() > 0;
+}
+
+static auto sameEffects(const FunctionEffects &a, const FunctionEffects &b) -> bool {
+  return a.noUnwind == b.noUnwind && a.willReturn == b.willReturn &&
+         a.memory == b.memory && a.noAliasReturn == b.noAliasReturn &&
+         a.noCaptureArgs == b.noCaptureArgs;
+}
+
+auto AttributeInference::run(ProgramNode &program) -> void {
+  CallGraph graph(program);
+
+  for (auto &scc: graph.getSCCs()) {
+    // start optimistic and lower the facts until the component is stable
+    for (auto id: scc) {
+      auto &node = graph.getNode(id);
+      auto arity = node.isExtern() ? node.ext->getProto()->getArgs().size()
+                                   : node.func->getProto()->getArgs().size();
+
+      if (node.isExtern()) {
+        effects[node.name] = conservativeEffects(arity);
+      } else {
+        FunctionEffects optimistic;
+        optimistic.noAliasReturn = isPointerType(node.func->getProto()->getReturnType());
+        optimistic.noCaptureArgs.assign(arity, true);
+        effects[node.name] = optimistic;
+      }
+    }
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+
+      for (auto id: scc) {
+        auto &node = graph.getNode(id);
+        if (node.isExtern()) {
+          continue;
+        }
+
+        auto inferred = inferFunction(graph, id, graph.isRecursive(id, scc));
+        if (!sameEffects(inferred, effects[node.name])) {
+          effects[node.name] = inferred;
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+auto AttributeInference::lookup(const std::string &name) const -> const FunctionEffects * {
+  auto found = effects.find(name);
+  if (found == effects.end()) {
+    return nullptr;
+  }
+
+  return &found->second;
+}
+
+auto AttributeInference::conservativeEffects(usize arity) const -> FunctionEffects {
+  FunctionEffects conservative;
+  conservative.noUnwind = false;
+  conservative.willReturn = false;
+  conservative.memory = MemoryEffect::Write;
+  conservative.noCaptureArgs.assign(arity, false);
+  return conservative;
+}
+
+auto AttributeInference::inferFunction(const CallGraph &graph, usize id, bool recursive)
+    -> FunctionEffects {
+  auto &func = *graph.getNode(id).func;
+  auto args = func.getProto()->getArgs();
+
+  FunctionEffects result;
+  // there are no loops in the language yet, so only recursion can fail to terminate
+  result.willReturn = !recursive;
+
+  walkAst(func.getBody(), [&](AstNode &expr) {
+    if (expr.is<SubscriptNode>()) {
+      result.memory = std::max(result.memory, MemoryEffect::Read);
+      return;
+    }
+
+    auto call = expr.as<CallNode>();
+    if (!call) {
+      return;
+    }
+
+    auto callee = lookup(call->getCallee());
+    auto calleeEffects = callee ? *callee : conservativeEffects(call->getArgs().size());
+    result.noUnwind &= calleeEffects.noUnwind;
+    result.willReturn &= calleeEffects.willReturn;
+    result.memory = std::max(result.memory, calleeEffects.memory);
+  });
+
+  for (auto &arg: args) {
+    result.noCaptureArgs.push_back(isPointerType(arg->type) &&
+                                   !captures(func.getBody(), arg->name, false));
+  }
+
+  result.noAliasReturn = isPointerType(func.getProto()->getReturnType()) &&
+                         returnsNoAlias(func.getBody());
+
+  return result;
+}
+
+// whether `param` may outlive the call through `node`, where `escapes` says if the
+// value of `node` itself is stored, returned or passed on
+auto AttributeInference::captures(const std::shared_ptr<AstNode> &node,
+                                  const std::string &param, bool escapes) const -> bool {
+  if (!node) {
+    return false;
+  }
+
+  if (auto var = node->as<VariableNode>()) {
+    return escapes && var->getName() == param;
+  }
+
+  if (auto bin = node->as<BinaryNode>()) {
+    auto isAssign = bin->getOp() == TokenKind::Equal || bin->getOp() == TokenKind::ColonEqual;
+    return captures(bin->getLhs(), param, false) ||
+           captures(bin->getRhs(), param, isAssign || escapes);
+  }
+
+  if (auto unary = node->as<UnaryNode>()) {
+    return captures(unary->getOperand(), param, false);
+  }
+
+  if (auto ifNode = node->as<IfNode>()) {
+    return captures(ifNode->getCondition(), param, false) ||
+           captures(ifNode->getThenBlock(), param, escapes) ||
+           captures(ifNode->getElseBlock(), param, escapes);
+  }
+
+  if (auto let = node->as<LetNode>()) {
+    // aliases aren't tracked, so binding the pointer to another name escapes it
+    return captures(let->getValue(), param, true);
+  }
+
+  if (auto block = node->as<BlockNode>()) {
+    auto stmts = block->getNodes();
+    for (usize i = 0; i < stmts.size(); ++i) {
+      if (captures(stmts[i], param, i + 1 == stmts.size() && escapes)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  if (auto single = node->as<SingleOpNode>()) {
+    return captures(single->getExpr(), param, true);
+  }
+
+  if (auto call = node->as<CallNode>()) {
+    auto callee = lookup(call->getCallee());
+    auto args = call->getArgs();
+    for (usize i = 0; i < args.size(); ++i) {
+      auto noCapture = callee && i < callee->noCaptureArgs.size() &&
+                       callee->noCaptureArgs[i];
+      if (captures(args[i], param, !noCapture)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  if (auto subscript = node->as<SubscriptNode>()) {
+    return captures(subscript->getOperand(), param, false) ||
+           captures(subscript->getIndex(), param, false);
+  }
+
+  return false;
+}
+
+// whether the value `node` evaluates to when control falls off its end is the result
+// of a call known to return an unaliased pointer; an explicit return leaves nothing to
+// check here since returnsNoAlias looks at those separately
+auto AttributeInference::tailNoAlias(const std::shared_ptr<AstNode> &node) const -> bool {
+  if (!node) {
+    return false;
+  }
+
+  if (auto single = node->as<SingleOpNode>()) {
+    return single->getOp() == TokenKind::Return;
+  }
+
+  if (auto block = node->as<BlockNode>()) {
+    auto stmts = block->getNodes();
+    return !stmts.empty() && tailNoAlias(stmts.back());
+  }
+
+  if (auto ifNode = node->as<IfNode>()) {
+    return tailNoAlias(ifNode->getThenBlock()) && tailNoAlias(ifNode->getElseBlock());
+  }
+
+  if (auto call = node->as<CallNode>()) {
+    auto callee = lookup(call->getCallee());
+    return callee && callee->noAliasReturn;
+  }
+
+  return false;
+}
+
+// a returned pointer is only unaliased if every return, and the body's own tail
+// value, hands back the result of a call known to return an unaliased pointer
+auto AttributeInference::returnsNoAlias(const std::shared_ptr<AstNode> &body) const -> bool {
+  bool noAlias = tailNoAlias(body);
+
+  walkAst(body, [&](AstNode &expr) {
+    auto single = expr.as<SingleOpNode>();
+    if (!single || single->getOp() != TokenKind::Return) {
+      return;
+    }
+
+    auto call = single->getExpr() ? single->getExpr()->as<CallNode>() : nullptr;
+    auto callee = call ? lookup(call->getCallee()) : nullptr;
+    noAlias &= callee && callee->noAliasReturn;
+  });
+
+  return noAlias;
+}
+
+auto AttributeInference::apply(llvm::Function &func) const -> void {
+  auto fx = lookup(func.getName().str());
+  if (!fx) {
+    return;
+  }
+
+  if (fx->noUnwind) {
+    func.addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  if (fx->willReturn) {
+    func.addFnAttr(llvm::Attribute::WillReturn);
+  }
+  if (fx->memory == MemoryEffect::None) {
+    func.addFnAttr(llvm::Attribute::ReadNone);
+  } else if (fx->memory == MemoryEffect::Read) {
+    func.addFnAttr(llvm::Attribute::ReadOnly);
+  }
+
+  if (fx->noAliasReturn && func.getReturnType()->isPointerTy()) {
+    func.addRetAttr(llvm::Attribute::NoAlias);
+  }
+
+  for (auto &arg: func.args()) {
+    if (arg.getArgNo() < fx->noCaptureArgs.size() && fx->noCaptureArgs[arg.getArgNo()] &&
+        arg.getType()->isPointerTy()) {
+      arg.addAttr(llvm::Attribute::NoCapture);
+    }
+  }
+}
+
+auto AttributeInference::apply(llvm::CallInst &call, const std::string &callee) const
+    -> void {
+  auto fx = lookup(callee);
+  if (!fx) {
+    return;
+  }
+
+  if (fx->noUnwind) {
+    call.addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  if (fx->willReturn) {
+    call.addFnAttr(llvm::Attribute::WillReturn);
+  }
+  if (fx->memory == MemoryEffect::None) {
+    call.addFnAttr(llvm::Attribute::ReadNone);
+  } else if (fx->memory == MemoryEffect::Read) {
+    call.addFnAttr(llvm::Attribute::ReadOnly);
+  }
+
+  for (usize i = 0; i < call.arg_size() && i < fx->noCaptureArgs.size(); ++i) {
+    if (fx->noCaptureArgs[i] && call.getArgOperand(i)->getType()->isPointerTy()) {
+      call.addParamAttr(i, llvm::Attribute::NoCapture);
+    }
+  }
+}
+
+} // namespace fern
@@ -0,0 +1,130 @@
+#include "Analysis/CallGraph.hpp"
+#include <algorithm>
+#include <functional>
+#include "AST/AstWalk.hpp"
+#include "AST/Nodes.hpp"
+
+namespace fern {
+
+CallGraph::CallGraph(ProgramNode &program) {
+  for (auto &ext: program.getExterns()) {
+    nodeIds.emplace(ext->getName(), nodes.size());
+    nodes.push_back(Node{ext->getName(), nullptr, ext.get(), {}});
+  }
+
+  for (auto &func: program.getFunctions()) {
+    nodeIds.emplace(func->getName(), nodes.size());
+    nodes.push_back(Node{func->getName(), func.get(), nullptr, {}});
+  }
+
+  for (auto &node: nodes) {
+    if (!node.func) {
+      continue;
+    }
+
+    walkAst(node.func->getBody(), [&](AstNode &expr) {
+      auto call = expr.as<CallNode>();
+      if (!call) {
+        return;
+      }
+
+      // unknown callees are reported by sema
+      if (auto callee = lookup(call->getCallee())) {
+        if (std::find(node.callees.begin(), node.callees.end(), *callee) ==
+            node.callees.end()) {
+          node.callees.push_back(*callee);
+        }
+      }
+    });
+  }
+}
+
+auto CallGraph::lookup(const std::string &name) const -> std::optional<usize> {
+  auto found = nodeIds.find(name);
+  if (found == nodeIds.end()) {
+    return std::nullopt;
+  }
+
+  return found->second;
+}
+
+auto CallGraph::getSCCs() const -> std::vector<std::vector<usize>> {
+  // tarjan's algorithm, which emits components in reverse topological order
+  constexpr usize unvisited = ~usize(0);
+  std::vector<usize> index(nodes.size(), unvisited);
+  std::vector<usize> lowLink(nodes.size(), 0);
+  std::vector<bool> onStack(nodes.size(), false);
+  std::vector<usize> stack;
+  std::vector<std::vector<usize>> sccs;
+  usize nextIndex = 0;
+
+  std::function<void(usize)> connect = [&](usize id) {
+    index[id] = lowLink[id] = nextIndex++;
+    stack.push_back(id);
+    onStack[id] = true;
+
+    for (auto callee: nodes[id].callees) {
+      if (index[callee] == unvisited) {
+        connect(callee);
+        lowLink[id] = std::min(lowLink[id], lowLink[callee]);
+      } else if (onStack[callee]) {
+        lowLink[id] = std::min(lowLink[id], index[callee]);
+      }
+    }
+
+    if (lowLink[id] != index[id]) {
+      return;
+    }
+
+    auto &scc = sccs.emplace_back();
+    usize member;
+    do {
+      member = stack.back();
+      stack.pop_back();
+      onStack[member] = false;
+      scc.push_back(member);
+    } while (member != id);
+  };
+
+  for (usize id = 0; id < nodes.size(); ++id) {
+    if (index[id] == unvisited) {
+      connect(id);
+    }
+  }
+
+  return sccs;
+}
+
+auto CallGraph::getReachable(const std::vector<usize> &roots) const -> std::vector<bool> {
+  std::vector<bool> reachable(nodes.size(), false);
+  std::vector<usize> worklist(roots.begin(), roots.end());
+
+  while (!worklist.empty()) {
+    auto id = worklist.back();
+    worklist.pop_back();
+
+    if (reachable[id]) {
+      continue;
+    }
+    reachable[id] = true;
+
+    for (auto callee: nodes[id].callees) {
+      if (!reachable[callee]) {
+        worklist.push_back(callee);
+      }
+    }
+  }
+
+  return reachable;
+}
+
+auto CallGraph::isRecursive(usize id, const std::vector<usize> &scc) const -> bool {
+  if (scc.size() > 1) {
+    return true;
+  }
+
+  auto &callees = nodes[id].callees;
+  return std::find(callees.begin(), callees.end(), id) != callees.end();
+}
+
+} // namespace fern
@@ -0,0 +1,57 @@
+#include "Analysis/DeadDeclElimination.hpp"
+#include <algorithm>
+#include "AST/AstWalk.hpp"
+#include "AST/Nodes.hpp"
+#include "Analysis/CallGraph.hpp"
+
+namespace fern {
+
+static auto countNodes(const std::shared_ptr<AstNode> &body) -> usize {
+  usize count = 0;
+  walkAst(body, [&](AstNode &) { count++; });
+  return count;
+}
+
+auto eliminateDeadDecls(ProgramNode &program) -> DeadDeclStats {
+  CallGraph graph(program);
+  DeadDeclStats stats;
+
+  std::vector<usize> roots;
+  for (usize id = 0; id < graph.size(); ++id) {
+    auto &node = graph.getNode(id);
+    if (node.func && (node.name == "main" || node.func->getProto()->isExported())) {
+      roots.push_back(id);
+    }
+  }
+
+  if (roots.empty()) {
+    return stats;
+  }
+
+  auto reachable = graph.getReachable(roots);
+  auto isReachable = [&](const std::string &name) { return reachable[*graph.lookup(name)]; };
+
+  auto &functions = program.getFunctionsMutable();
+  auto deadFunctions = std::stable_partition(functions.begin(), functions.end(),
+                                             [&](auto &func) { return isReachable(func->getName()); });
+  for (auto it = functions.begin(); it != functions.end(); ++it) {
+    auto nodes = countNodes((*it)->getBody());
+    if (it < deadFunctions) {
+      stats.keptNodes += nodes;
+    } else {
+      stats.removedNodes += nodes;
+      stats.removedFunctions++;
+    }
+  }
+  functions.erase(deadFunctions, functions.end());
+
+  auto &externs = program.getExternsMutable();
+  auto deadExterns = std::stable_partition(externs.begin(), externs.end(),
+                                           [&](auto &ext) { return isReachable(ext->getName()); });
+  stats.removedExterns = std::distance(deadExterns, externs.end());
+  externs.erase(deadExterns, externs.end());
+
+  return stats;
+}
+
+} // namespace fern
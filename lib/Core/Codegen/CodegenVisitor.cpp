@@ -1,8 +1,13 @@
 #include "Codegen/CodegenVisitor.hpp"
+#include "Codegen/DebugInfo.hpp"
+#include "Codegen/Multiversioning.hpp"
+#include "Analysis/AttributeInference.hpp"
 #include "Sema/Type.hpp"
 #include "AST/Nodes.hpp"
 #include "Errors/Context.hpp"
 #include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Verifier.h"
 
 namespace fern {
@@ -34,20 +39,42 @@ auto CodegenVisitor::visit(Function &node) -> void {
   }
 
   currentFunction = func;
+  ctx.getBuilder().SetInsertPoint(llvm::BasicBlock::Create(ctx.getLLVMContext(), "entry", func));
+  beginFunctionBody(*func, *node.getProto());
 
-  varValueTable.incScope();
+  varSlotTable.incScope();
   for (auto &arg: func->args()) {
-    varValueTable.insert(arg.getName().data(), &arg);
+    auto slot = createSlot(arg.getType(), arg.getName().str());
+    ctx.getBuilder().CreateStore(&arg, slot);
+    varSlotTable.insert(arg.getName().str(), slot);
+    if (debugInfo) {
+      debugInfo->declareVariable(slot, arg.getName().str(),
+                                 node.getProto()->getArgs()[arg.getArgNo()]->type,
+                                 node.getProto()->getLocation(), arg.getArgNo() + 1,
+                                 ctx.getBuilder().GetInsertBlock());
+    }
+  }
+
+  llvm::Value *value = node.getBody()->codegen(*this);
+  if (!isTerminated()) {
+    auto returnType = func->getReturnType();
+    if (returnType->isVoidTy()) {
+      ctx.getBuilder().CreateRetVoid();
+    } else if (value && value->getType() == returnType) {
+      ctx.getBuilder().CreateRet(value);
+    } else {
+      ctx.getBuilder().CreateUnreachable();
+    }
   }
+  endFunctionBody();
 
-  node.getBody()->codegen(*this);
-  if (verifyFunction(*func, &llvm::errs())) {
+  if (verifyFunctions && verifyFunction(*func, &llvm::errs())) {
     ctx.recordError("llvm function verification failed", node.getProto()->getLocation());
     func->print(llvm::errs());
     func->eraseFromParent();
   }
 
-  varValueTable.decScope();
+  varSlotTable.decScope();
 }
 
 auto CodegenVisitor::visit(ExternDef &node) -> void {
@@ -98,7 +125,14 @@ auto CodegenVisitor::visit(Prototype &node) -> llvm::Function * {
   }
 
   llvm::FunctionType *funcType = llvm::FunctionType::get(node.getReturnType().codegen(*this), argTypes, false);
-  llvm::Function *func = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, node.getName(), &ctx.getModule());
+  // Fern has no function values, so every call to an internal function is direct
+  // and no C-compatible thunks are needed
+  auto linkage = node.isExternallyVisible() ? llvm::Function::ExternalLinkage
+                                            : llvm::Function::InternalLinkage;
+  llvm::Function *func = llvm::Function::Create(funcType, linkage, node.getName(), &ctx.getModule());
+  if (!node.isExternallyVisible()) {
+    func->setCallingConv(llvm::CallingConv::Fast);
+  }
 
   if (func->getName() != node.getName()) {
     func->eraseFromParent();
@@ -117,32 +151,82 @@ auto CodegenVisitor::visit(Prototype &node) -> llvm::Function * {
     arg.setName(node.getArgs()[i++]->name);
   }
 
+  if (attrInference) {
+    attrInference->apply(*func);
+  }
+
+  if (!node.isExtern()) {
+    if (!targetCPU.empty()) {
+      func->addFnAttr("target-cpu", targetCPU);
+    }
+    if (!targetFeatures.empty()) {
+      func->addFnAttr("target-features", targetFeatures);
+    }
+  }
+
+  // picked up by the optimizer
+  if (auto opt = node.getAnnotation("optimize")) {
+    func->addFnAttr("fern-opt-level", opt->args[0]);
+  }
+
+  // expanded by `emitTargetClones` once the body exists
+  if (auto clones = node.getAnnotation("target_clones"); clones && !node.isExtern()) {
+    func->addFnAttr(targetClonesAttr, llvm::join(clones->args, ","));
+  }
+
+  // `.text.hot`/`.text.unlikely`, the cold ones also get split out by the optimizer
+  if (!node.isExtern() && node.hasAnnotation("hot")) {
+    func->addFnAttr(llvm::Attribute::Hot);
+    func->setSectionPrefix("hot");
+  } else if (!node.isExtern() && node.hasAnnotation("cold")) {
+    func->addFnAttr(llvm::Attribute::Cold);
+    func->setSectionPrefix("unlikely");
+  }
+
   return func;
 }
 
 auto CodegenVisitor::visit(BinaryNode &node) -> llvm::Value * {
+  emitLocation(node.getLocation());
   llvm::Value *rhs = node.getRhs()->codegen(*this);
   if (!rhs) {
     return nullptr;
   }
 
+  if (node.getOp() == TokenKind::Equal || node.getOp() == TokenKind::ColonEqual) {
+    auto name = node.getLhs()->as<VariableNode>()->getName();
+    llvm::AllocaInst *slot = varSlotTable.lookup(name);
+    if (!slot) {
+      ctx.recordError("variable not found", node.getLhs()->getLocation());
+      return nullptr;
+    }
+
+    if (slot->getAllocatedType() != rhs->getType()) {
+      ctx.recordError("cannot reassign variable with different type", node.getLocation());
+      ctx.recordNote(fmt::format("variable `{}` expected type {}, got {}", name,
+                                 node.getLhs()->getType().getTypeName(),
+                                 node.getRhs()->getType().getTypeName()));
+      return nullptr;
+    }
+
+    emitLocation(node.getLocation());
+    ctx.getBuilder().CreateStore(rhs, slot);
+    return rhs;
+  }
+
   llvm::Value *lhs = node.getLhs()->codegen(*this);
   if (!lhs) {
     return nullptr;
   }
 
+  // the operands moved the location along
+  emitLocation(node.getLocation());
+  bool isFloat = lhs->getType()->isFloatingPointTy();
+  if (isFloat) {
+    return emitFloatOp(node, lhs, rhs);
+  }
+
   switch (node.getOp()) {
-    case TokenKind::Equal:
-    case TokenKind::ColonEqual:
-      if (lhs->getType() != rhs->getType()) {
-        ctx.recordError("cannot reassign variable with different type", node.getLocation());
-        ctx.recordNote(fmt::format("variable `{}` expected type {}, got {}",
-                                   node.getLhs()->as<VariableNode>()->getName(),
-                                   node.getLhs()->getType().getTypeName(),
-                                   node.getRhs()->getType().getTypeName()));
-        return nullptr;
-      }
-      return ctx.getBuilder().CreateStore(rhs, varValueTable.lookup(node.getLhs()->as<VariableNode>()->getName()));
     case TokenKind::EqualEqual:
       return ctx.getBuilder().CreateICmpEQ(lhs, rhs, "eqtmp");
     case TokenKind::BangEqual:
@@ -154,6 +238,13 @@ auto CodegenVisitor::visit(BinaryNode &node) -> llvm::Value * {
     case TokenKind::Star:
       return ctx.getBuilder().CreateMul(lhs, rhs, "multmp");
     case TokenKind::Slash:
+      // sema types every division as float
+      if (node.getType() == Type::Float()) {
+        auto floatType = llvm::Type::getFloatTy(ctx.getLLVMContext());
+        lhs = ctx.getBuilder().CreateSIToFP(lhs, floatType, "convtmp");
+        rhs = ctx.getBuilder().CreateSIToFP(rhs, floatType, "convtmp");
+        return emitFloatOp(node, lhs, rhs);
+      }
       return ctx.getBuilder().CreateSDiv(lhs, rhs, "divtmp");
     case TokenKind::Less:
       return ctx.getBuilder().CreateICmpSLT(lhs, rhs, "lttmp");
@@ -171,14 +262,48 @@ auto CodegenVisitor::visit(BinaryNode &node) -> llvm::Value * {
   return nullptr;
 }
 
+auto CodegenVisitor::emitFloatOp(BinaryNode &node, llvm::Value *lhs, llvm::Value *rhs)
+    -> llvm::Value * {
+  switch (node.getOp()) {
+  case TokenKind::EqualEqual:
+    return ctx.getBuilder().CreateFCmpOEQ(lhs, rhs, "eqtmp");
+  case TokenKind::BangEqual:
+    return ctx.getBuilder().CreateFCmpUNE(lhs, rhs, "neqtmp");
+  case TokenKind::Plus:
+    return ctx.getBuilder().CreateFAdd(lhs, rhs, "addtmp");
+  case TokenKind::Minus:
+    return ctx.getBuilder().CreateFSub(lhs, rhs, "subtmp");
+  case TokenKind::Star:
+    return ctx.getBuilder().CreateFMul(lhs, rhs, "multmp");
+  case TokenKind::Slash:
+    return ctx.getBuilder().CreateFDiv(lhs, rhs, "divtmp");
+  case TokenKind::Less:
+    return ctx.getBuilder().CreateFCmpOLT(lhs, rhs, "lttmp");
+  case TokenKind::LessEqual:
+    return ctx.getBuilder().CreateFCmpOLE(lhs, rhs, "letmp");
+  case TokenKind::Greater:
+    return ctx.getBuilder().CreateFCmpOGT(lhs, rhs, "gttmp");
+  case TokenKind::GreaterEqual:
+    return ctx.getBuilder().CreateFCmpOGE(lhs, rhs, "getmp");
+  default:
+    ctx.recordError("invalid binary op", node.getLocation());
+    return nullptr;
+  }
+}
+
 auto CodegenVisitor::visit(UnaryNode &node) -> llvm::Value * {
+  emitLocation(node.getLocation());
   llvm::Value *rhs = node.getOperand()->codegen(*this);
   if (!rhs) {
     return nullptr;
   }
 
+  emitLocation(node.getLocation());
   switch (node.getOp().getKind()) {
   case TokenKind::Minus:
+    if (rhs->getType()->isFloatingPointTy()) {
+      return ctx.getBuilder().CreateFNeg(rhs, "negtmp");
+    }
     return ctx.getBuilder().CreateNeg(rhs, "negtmp");
   case TokenKind::Bang:
     return ctx.getBuilder().CreateNot(rhs, "nottmp");
@@ -188,29 +313,72 @@ auto CodegenVisitor::visit(UnaryNode &node) -> llvm::Value * {
   }
 }
 
+auto CodegenVisitor::createCondBr(llvm::Value *cond, llvm::BasicBlock *thenBlock,
+                                  llvm::BasicBlock *elseBlock, BranchHint hint)
+    -> llvm::BranchInst * {
+  // the weights `llvm.expect` is lowered to
+  constexpr u32 likelyWeight = 2000;
+  constexpr u32 unlikelyWeight = 1;
+
+  auto branch = ctx.getBuilder().CreateCondBr(cond, thenBlock, elseBlock);
+  if (hint != BranchHint::None) {
+    llvm::MDBuilder md(ctx.getLLVMContext());
+    branch->setMetadata(llvm::LLVMContext::MD_prof,
+                        hint == BranchHint::Likely
+                            ? md.createBranchWeights(likelyWeight, unlikelyWeight)
+                            : md.createBranchWeights(unlikelyWeight, likelyWeight));
+  }
+  return branch;
+}
+
 auto CodegenVisitor::visit(IfNode &node) -> llvm::Value * {
+  emitLocation(node.getLocation());
   llvm::Value *cond = node.getCondition()->codegen(*this);
   if (!cond) {
     return nullptr;
   }
+  emitLocation(node.getLocation());
 
   llvm::Function *func = ctx.getBuilder().GetInsertBlock()->getParent();
-  
+  llvm::BasicBlock *thenBlock = llvm::BasicBlock::Create(ctx.getLLVMContext(), "then", func);
+  llvm::BasicBlock *elseBlock =
+      node.hasElseBlock() ? llvm::BasicBlock::Create(ctx.getLLVMContext(), "else", func) : nullptr;
+  llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(ctx.getLLVMContext(), "ifcont", func);
+  createCondBr(cond, thenBlock, elseBlock ? elseBlock : mergeBlock, node.getHint());
+
+  ctx.getBuilder().SetInsertPoint(thenBlock);
   llvm::Value *thenBlockValue = node.getThenBlock()->codegen(*this);
-  llvm::BasicBlock *thenBlock = ctx.getBuilder().GetInsertBlock();
+  thenBlock = ctx.getBuilder().GetInsertBlock();
+  bool thenReturns = isTerminated();
+  if (!thenReturns) {
+    ctx.getBuilder().CreateBr(mergeBlock);
+  }
 
   llvm::Value *elseBlockValue = nullptr;
-  llvm::BasicBlock *elseBlock = nullptr;
-  if (auto elseBlockNode = node.getElseBlock()) {
-    elseBlockValue = elseBlockNode->codegen(*this);
+  bool elseReturns = false;
+  if (elseBlock) {
+    ctx.getBuilder().SetInsertPoint(elseBlock);
+    elseBlockValue = node.getElseBlock()->codegen(*this);
     elseBlock = ctx.getBuilder().GetInsertBlock();
+    elseReturns = isTerminated();
+    if (!elseReturns) {
+      ctx.getBuilder().CreateBr(mergeBlock);
+    }
   }
 
-  llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(ctx.getLLVMContext(), "ifcont", func);
-  ctx.getBuilder().CreateCondBr(cond, thenBlock, elseBlock ? elseBlock : mergeBlock);
   ctx.getBuilder().SetInsertPoint(mergeBlock);
+  if (thenReturns && elseReturns) {
+    // nothing after the if is reachable, the enclosing block stops here
+    ctx.getBuilder().CreateUnreachable();
+    return nullptr;
+  }
 
-  if (thenBlockValue && elseBlockValue) {
+  if (thenReturns || elseReturns) {
+    return nullptr;
+  }
+
+  if (thenBlockValue && elseBlockValue && thenBlockValue->getType() == elseBlockValue->getType() &&
+      !thenBlockValue->getType()->isVoidTy()) {
     llvm::PHINode *phi = ctx.getBuilder().CreatePHI(thenBlockValue->getType(), 2, "iftmp");
     phi->addIncoming(thenBlockValue, thenBlock);
     phi->addIncoming(elseBlockValue, elseBlock);
@@ -221,28 +389,54 @@ auto CodegenVisitor::visit(IfNode &node) -> llvm::Value * {
 }
 
 auto CodegenVisitor::visit(LetNode &node) -> llvm::Value * {
+  emitLocation(node.getLocation());
   llvm::Value *value = node.getValue()->codegen(*this);
   if (!value) {
     return nullptr;
   }
 
-  varValueTable.insert(node.getName(), value);
+  emitLocation(node.getLocation());
+  llvm::AllocaInst *slot = createSlot(value->getType(), node.getName());
+  startLifetime(slot);
+  ctx.getBuilder().CreateStore(value, slot);
+  varSlotTable.insert(node.getName(), slot);
+  if (debugInfo) {
+    debugInfo->declareVariable(slot, node.getName(), node.getValue()->getType(),
+                               node.getLocation(), 0, ctx.getBuilder().GetInsertBlock());
+  }
   return value;
 }
 
 auto CodegenVisitor::visit(BlockNode &node) -> llvm::Value * {
-  llvm::BasicBlock *block = llvm::BasicBlock::Create(ctx.getLLVMContext(), "block", currentFunction);
-  ctx.getBuilder().SetInsertPoint(block);
+  varSlotTable.incScope();
+  scopeSlots.emplace_back();
+  if (debugInfo) {
+    debugInfo->beginScope(node.getLocation());
+  }
 
-  std::vector<llvm::Value *> values;
+  llvm::Value *value = nullptr;
   for (auto &stmt: node.getNodes()) {
-    values.push_back(stmt->codegen(*this));
+    // statements after a return are dead
+    if (isTerminated()) {
+      break;
+    }
+    value = stmt->codegen(*this);
   }
 
-  return values.back() ? values.back() : nullptr;
+  endScope();
+  if (debugInfo) {
+    debugInfo->endScope();
+    // the last statement's location points into the closed block, which would leave
+    // merge branches and implicit returns in a scope that's already over
+    auto &builder = ctx.getBuilder();
+    builder.SetCurrentDebugLocation(debugInfo->getLocation(builder.getCurrentDebugLocation()));
+  }
+  varSlotTable.decScope();
+  return value;
 }
 
 auto CodegenVisitor::visit(SingleOpNode &node) -> llvm::Value * {
+  emitLocation(node.getLocation());
   if (node.getOp() == TokenKind::Return) {
     if (auto expr = node.getExpr()) {
       llvm::Value *value = expr->codegen(*this);
@@ -250,6 +444,7 @@ auto CodegenVisitor::visit(SingleOpNode &node) -> llvm::Value * {
         return nullptr;
       }
 
+      emitLocation(node.getLocation());
       return ctx.getBuilder().CreateRet(value);
     } else {
       return ctx.getBuilder().CreateRetVoid();
@@ -267,6 +462,7 @@ auto CodegenVisitor::visit(SingleOpNode &node) -> llvm::Value * {
 }
 
 auto CodegenVisitor::visit(CallNode &node) -> llvm::Value * {
+  emitLocation(node.getLocation());
   llvm::Function *func = ctx.getModule().getFunction(node.getCallee());
   if (!func) {
     ctx.recordError("function not found", node.getLocation());
@@ -286,21 +482,32 @@ auto CodegenVisitor::visit(CallNode &node) -> llvm::Value * {
     }
   }
 
-  return ctx.getBuilder().CreateCall(func, args, "calltmp");
+  // the arguments moved the location along
+  emitLocation(node.getLocation());
+  // void values can't carry a name
+  auto name = func->getReturnType()->isVoidTy() ? "" : "calltmp";
+  llvm::CallInst *call = ctx.getBuilder().CreateCall(func, args, name);
+  call->setCallingConv(func->getCallingConv());
+  if (attrInference) {
+    attrInference->apply(*call, node.getCallee());
+  }
+
+  return call;
 }
 
 auto CodegenVisitor::visit(VariableNode &node) -> llvm::Value * {
-  llvm::Value *value = varValueTable.lookup(node.getName());
-  if (!value) {
+  emitLocation(node.getLocation());
+  llvm::AllocaInst *slot = varSlotTable.lookup(node.getName());
+  if (!slot) {
     ctx.recordError("variable not found", node.getLocation());
     return nullptr;
   }
 
-  // return ctx.getBuilder().CreateLoad(value, node.getName());
-  return ctx.getBuilder().CreateLoad(node.getType().codegen(*this), value, node.getName());
+  return ctx.getBuilder().CreateLoad(slot->getAllocatedType(), slot, node.getName());
 }
 
 auto CodegenVisitor::visit(SubscriptNode &node) -> llvm::Value * {
+  emitLocation(node.getLocation());
   llvm::Value *operand = node.getOperand()->codegen(*this);
   if (!operand) {
     return nullptr;
@@ -311,7 +518,10 @@ auto CodegenVisitor::visit(SubscriptNode &node) -> llvm::Value * {
     return nullptr;
   }
 
-  return ctx.getBuilder().CreateGEP(node.getIndexedType().codegen(*this), operand, index, "subscripttmp");
+  emitLocation(node.getLocation());
+  llvm::Type *elemType = node.getIndexedType().codegen(*this);
+  llvm::Value *elemPtr = ctx.getBuilder().CreateGEP(elemType, operand, index, "subscripttmp");
+  return ctx.getBuilder().CreateLoad(elemType, elemPtr, "elemtmp");
 }
 
 auto CodegenVisitor::visit(BooleanNode &node) -> llvm::Value * {
@@ -322,7 +532,9 @@ auto CodegenVisitor::visit(NumberNode &node) -> llvm::Value * {
   if (node.getType() == Type::Int()) {
     return llvm::ConstantInt::get(ctx.getLLVMContext(), llvm::APInt(32, node.getValue(), 10));
   } else if (node.getType() == Type::Float()) {
-    return llvm::ConstantFP::get(ctx.getLLVMContext(), llvm::APFloat(llvm::APFloat::IEEEdouble(), node.getValue()));
+    // parsed in the precision it's stored in, so the literal is rounded once
+    auto floatType = node.getType().codegen(*this);
+    return llvm::ConstantFP::get(floatType, node.getValue());
   } else {
     ctx.recordError("invalid number type", node.getLocation());
     return nullptr;
@@ -330,7 +542,79 @@ auto CodegenVisitor::visit(NumberNode &node) -> llvm::Value * {
 }
 
 auto CodegenVisitor::visit(StringNode &node) -> llvm::Value * {
-  return ctx.getBuilder().CreateGlobalStringPtr(node.getValue());
+  return getStringLiteral(node.getValue());
+}
+
+auto CodegenVisitor::beginFunctionBody(llvm::Function &func, const Prototype &proto) -> void {
+  if (debugInfo) {
+    debugInfo->beginFunction(func, proto);
+    emitLocation(proto.getLocation());
+  }
+
+  if (!fastMath && !proto.hasAnnotation("fastmath")) {
+    ctx.getBuilder().clearFastMathFlags();
+    return;
+  }
+
+  llvm::FastMathFlags flags;
+  flags.setFast();
+  ctx.getBuilder().setFastMathFlags(flags);
+
+  // what clang sets for `-ffast-math`, the backend reads these per function
+  func.addFnAttr("unsafe-fp-math", "true");
+  func.addFnAttr("no-nans-fp-math", "true");
+  func.addFnAttr("no-infs-fp-math", "true");
+  func.addFnAttr("no-signed-zeros-fp-math", "true");
+  func.addFnAttr("approx-func-fp-math", "true");
+}
+
+auto CodegenVisitor::endFunctionBody() -> void {
+  if (debugInfo) {
+    debugInfo->endFunction();
+  }
+  // a location left over from this function would be in the wrong subprogram for the next
+  ctx.getBuilder().SetCurrentDebugLocation(llvm::DebugLoc());
+}
+
+auto CodegenVisitor::emitLocation(SourceLocation loc) -> void {
+  if (debugInfo) {
+    ctx.getBuilder().SetCurrentDebugLocation(debugInfo->getLocation(loc));
+  }
+}
+
+auto CodegenVisitor::getStringLiteral(std::string_view value) -> llvm::Constant * {
+  auto [it, inserted] = stringPool.try_emplace(std::string(value), nullptr);
+  if (inserted) {
+    it->second = ctx.getBuilder().CreateGlobalStringPtr(value, ".str", 0, &ctx.getModule());
+  }
+  return it->second;
+}
+
+auto CodegenVisitor::createSlot(llvm::Type *type, const std::string &name) -> llvm::AllocaInst * {
+  llvm::BasicBlock &entry = currentFunction->getEntryBlock();
+  llvm::IRBuilder<> builder(&entry, entry.begin());
+  return builder.CreateAlloca(type, nullptr, name + ".addr");
+}
+
+auto CodegenVisitor::startLifetime(llvm::AllocaInst *slot) -> void {
+  auto size = ctx.getModule().getDataLayout().getTypeAllocSize(slot->getAllocatedType());
+  ctx.getBuilder().CreateLifetimeStart(slot, ctx.getBuilder().getInt64(size));
+  scopeSlots.back().push_back(slot);
+}
+
+auto CodegenVisitor::endScope() -> void {
+  // a return already ends every lifetime
+  if (!isTerminated()) {
+    for (auto it = scopeSlots.back().rbegin(); it != scopeSlots.back().rend(); ++it) {
+      auto size = ctx.getModule().getDataLayout().getTypeAllocSize((*it)->getAllocatedType());
+      ctx.getBuilder().CreateLifetimeEnd(*it, ctx.getBuilder().getInt64(size));
+    }
+  }
+  scopeSlots.pop_back();
+}
+
+auto CodegenVisitor::isTerminated() -> bool {
+  return ctx.getBuilder().GetInsertBlock()->getTerminator() != nullptr;
 }
 
 }
@@ -0,0 +1,167 @@
+#include "Codegen/DebugInfo.hpp"
+#include "AST/Prototype.hpp"
+#include "FernConfig.hpp"
+#include "Sema/Type.hpp"
+#include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+namespace fern {
+
+namespace {
+
+// source locations count from 0, DWARF from 1
+auto line(SourceLocation loc) -> u32 {
+  return loc.getLine() + 1;
+}
+
+auto column(SourceLocation loc) -> u32 {
+  return loc.getColumn() + 1;
+}
+
+} // namespace
+
+DebugInfo::DebugInfo(llvm::Module &module, std::string_view filename, DebugInfoLevel level,
+                     bool optimized) :
+    module(module), level(level), optimized(optimized), builder(module) {
+  llvm::SmallString<128> directory;
+  llvm::sys::fs::current_path(directory);
+  file = builder.createFile(llvm::StringRef(filename.data(), filename.size()), directory);
+
+  // there's no language code for Fern, C is what debuggers handle best. `NoDebug`
+  // units keep their locations in the IR but emit no DWARF
+  auto kind = level == DebugInfoLevel::Full             ? llvm::DICompileUnit::FullDebug
+              : level == DebugInfoLevel::LineTablesOnly ? llvm::DICompileUnit::LineTablesOnly
+                                                        : llvm::DICompileUnit::NoDebug;
+  unit = builder.createCompileUnit(llvm::dwarf::DW_LANG_C, file,
+                                   std::string("fern ") + FernVersion, optimized, "", 0, "",
+                                   kind);
+
+  module.addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                       llvm::DEBUG_METADATA_VERSION);
+  module.addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+auto DebugInfo::beginFunction(llvm::Function &func, const Prototype &proto) -> void {
+  llvm::DISubroutineType *funcType;
+  if (isFull()) {
+    // the return type comes first, void as null
+    std::vector<llvm::Metadata *> types{getType(proto.getReturnType())};
+    for (auto &arg: proto.getArgs()) {
+      types.push_back(getType(arg->type));
+    }
+    funcType = builder.createSubroutineType(builder.getOrCreateTypeArray(types));
+  } else {
+    funcType = builder.createSubroutineType(builder.getOrCreateTypeArray({}));
+  }
+
+  auto flags = llvm::DISubprogram::SPFlagDefinition;
+  if (func.hasLocalLinkage()) {
+    flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+  }
+  if (optimized) {
+    flags |= llvm::DISubprogram::SPFlagOptimized;
+  }
+
+  auto loc = proto.getLocation();
+  // Fern doesn't mangle, so there's no linkage name to record
+  auto subprogram = builder.createFunction(file, proto.getName(), "", file,
+                                           line(loc), funcType, line(loc),
+                                           llvm::DINode::FlagPrototyped, flags);
+  func.setSubprogram(subprogram);
+  scopes.assign({subprogram});
+}
+
+auto DebugInfo::endFunction() -> void {
+  if (scopes.empty()) {
+    return;
+  }
+  builder.finalizeSubprogram(llvm::cast<llvm::DISubprogram>(scopes.front()));
+  scopes.clear();
+}
+
+auto DebugInfo::beginScope(SourceLocation loc) -> void {
+  // line tables don't care which block a line is in
+  if (!isFull() || scopes.empty()) {
+    return;
+  }
+  scopes.push_back(builder.createLexicalBlock(scopes.back(), file, line(loc), column(loc)));
+}
+
+auto DebugInfo::endScope() -> void {
+  if (isFull() && scopes.size() > 1) {
+    scopes.pop_back();
+  }
+}
+
+auto DebugInfo::getLocation(SourceLocation loc) -> llvm::DebugLoc {
+  if (scopes.empty()) {
+    return llvm::DebugLoc();
+  }
+  return llvm::DILocation::get(module.getContext(), line(loc), column(loc), scopes.back());
+}
+
+auto DebugInfo::getLocation(const llvm::DebugLoc &loc) -> llvm::DebugLoc {
+  if (!loc || scopes.empty()) {
+    return llvm::DebugLoc();
+  }
+  return llvm::DILocation::get(module.getContext(), loc.getLine(), loc.getCol(), scopes.back());
+}
+
+auto DebugInfo::declareVariable(llvm::AllocaInst *slot, const std::string &name,
+                                const Type &type, SourceLocation loc, u32 argNo,
+                                llvm::BasicBlock *block) -> void {
+  if (!isFull() || scopes.empty()) {
+    return;
+  }
+
+  auto scope = scopes.back();
+  auto diType = getType(type);
+  auto var = argNo > 0 ? builder.createParameterVariable(scope, name, argNo, file, line(loc),
+                                                          diType, optimized)
+                       : builder.createAutoVariable(scope, name, file, line(loc), diType,
+                                                    optimized);
+  builder.insertDeclare(slot, var, builder.createExpression(), getLocation(loc).get(), block);
+}
+
+auto DebugInfo::finalize() -> void {
+  endFunction();
+  builder.finalize();
+}
+
+auto DebugInfo::getType(const Type &type) -> llvm::DIType * {
+  llvm::DIType *diType = nullptr;
+  switch (type.getKind()) {
+  case TypeKind::Void:
+  case TypeKind::Invalid:
+    break;
+  case TypeKind::Bool:
+    diType = builder.createBasicType("bool", 8, llvm::dwarf::DW_ATE_boolean);
+    break;
+  case TypeKind::Int:
+    diType = builder.createBasicType("int", 32, llvm::dwarf::DW_ATE_signed);
+    break;
+  case TypeKind::Float:
+    diType = builder.createBasicType("float", 32, llvm::dwarf::DW_ATE_float);
+    break;
+  case TypeKind::Char:
+    diType = builder.createBasicType("char", 8, llvm::dwarf::DW_ATE_signed_char);
+    break;
+  case TypeKind::Str: {
+    auto pointee = builder.createBasicType("char", 8, llvm::dwarf::DW_ATE_signed_char);
+    diType = builder.createPointerType(pointee, module.getDataLayout().getPointerSizeInBits(),
+                                       0, llvm::None, "str");
+    break;
+  }
+  }
+
+  // references are plain pointers
+  auto pointerSize = module.getDataLayout().getPointerSizeInBits();
+  for (usize i = 0; diType && i < type.getReferenceDepth(); ++i) {
+    diType = builder.createPointerType(diType, pointerSize);
+  }
+  return diType;
+}
+
+} // namespace fern
@@ -0,0 +1,327 @@
+#include "Codegen/Emitter.hpp"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#ifdef FERN_HAS_LLD
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include "FernConfig.hpp"
+#include "lld/Common/Driver.h"
+#include "llvm/BinaryFormat/ELF.h"
+#include "llvm/Object/ELFObjectFile.h"
+#endif
+
+namespace fern {
+
+namespace {
+
+auto makeError(const llvm::Twine &message) -> llvm::Error {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), message);
+}
+
+// flushes `out`, so a full disk or a closed pipe surfaces as an error instead of being
+// dropped. the error is cleared, LLVM aborts on destroying a stream that still has one.
+// `-` is stdout, which the stream doesn't own and mustn't close
+auto closeOutput(llvm::raw_fd_ostream &out, const std::string &path) -> llvm::Error {
+  if (path == "-") {
+    out.flush();
+  } else {
+    out.close();
+  }
+  if (out.has_error()) {
+    auto ec = out.error();
+    out.clear_error();
+    return makeError("could not write " + path + ": " + ec.message());
+  }
+  return llvm::Error::success();
+}
+
+auto emitMachineCode(llvm::Module &module, llvm::TargetMachine &targetMachine,
+                     llvm::CodeGenFileType fileType, const std::string &path) -> llvm::Error {
+  std::error_code ec;
+  llvm::raw_fd_ostream out(path, ec,
+                           fileType == llvm::CGFT_AssemblyFile ? llvm::sys::fs::OF_Text
+                                                               : llvm::sys::fs::OF_None);
+  if (ec) {
+    return makeError("could not open " + path + ": " + ec.message());
+  }
+
+  llvm::legacy::PassManager pm;
+  if (targetMachine.addPassesToEmitFile(pm, out, nullptr, fileType)) {
+    return makeError("the target can't emit this file type");
+  }
+  pm.run(module);
+  return closeOutput(out, path);
+}
+
+#ifdef FERN_HAS_LLD
+// ';' separated lists from configuring fern, the C runtime files and libraries `cc`
+// itself would link an executable with
+auto splitConfigList(llvm::StringRef list) -> std::vector<std::string> {
+  llvm::SmallVector<llvm::StringRef, 8> items;
+  list.split(items, ';', -1, false);
+  return {items.begin(), items.end()};
+}
+
+// executables get the dynamic linker fern itself runs under
+auto hostInterpreter() -> std::optional<std::string> {
+  static auto interpreter = []() -> std::optional<std::string> {
+    auto binary = llvm::object::ObjectFile::createObjectFile("/proc/self/exe");
+    if (!binary) {
+      llvm::consumeError(binary.takeError());
+      return std::nullopt;
+    }
+
+    auto elf = llvm::dyn_cast<llvm::object::ELF64LEObjectFile>(binary->getBinary());
+    if (!elf) {
+      return std::nullopt;
+    }
+    auto &file = elf->getELFFile();
+    auto headers = file.program_headers();
+    if (!headers) {
+      llvm::consumeError(headers.takeError());
+      return std::nullopt;
+    }
+    for (auto &header: *headers) {
+      if (header.p_type == llvm::ELF::PT_INTERP) {
+        auto data = reinterpret_cast<const char *>(file.base() + header.p_offset);
+        return std::string(data, strnlen(data, header.p_filesz));
+      }
+    }
+    return std::nullopt;
+  }();
+  return interpreter;
+}
+
+// `cc` arguments turned into LLD ones, linker flags are passed through `-Wl,`
+auto toLinkerArgs(const std::vector<std::string> &args) -> std::vector<std::string> {
+  std::vector<std::string> linkerArgs;
+  for (auto &arg: args) {
+    llvm::StringRef ref(arg);
+    if (ref.startswith("-fuse-ld=")) {
+      continue;
+    }
+    if (ref.consume_front("-Wl,")) {
+      llvm::SmallVector<llvm::StringRef, 4> flags;
+      ref.split(flags, ',');
+      linkerArgs.insert(linkerArgs.end(), flags.begin(), flags.end());
+      continue;
+    }
+    linkerArgs.push_back(arg);
+  }
+  return linkerArgs;
+}
+
+auto linkWithLLD(const std::vector<std::string> &inputs, const std::string &path)
+    -> llvm::Error {
+  std::vector<std::string> args{"ld.lld", "--eh-frame-hdr", "-pie", "-z", "relro", "-z",
+                                "now", "--gc-sections", "--icf=safe", "-dynamic-linker",
+                                *hostInterpreter(), "-o", path};
+  auto startFiles = splitConfigList(FernLinkStartFiles);
+  auto libs = splitConfigList(FernLinkLibs);
+  auto endFiles = splitConfigList(FernLinkEndFiles);
+  auto linkerInputs = toLinkerArgs(inputs);
+  args.insert(args.end(), startFiles.begin(), startFiles.end());
+  args.insert(args.end(), linkerInputs.begin(), linkerInputs.end());
+  args.insert(args.end(), libs.begin(), libs.end());
+  args.insert(args.end(), endFiles.begin(), endFiles.end());
+
+  std::vector<const char *> argv;
+  for (auto &arg: args) {
+    argv.push_back(arg.c_str());
+  }
+
+  std::string errors;
+  llvm::raw_string_ostream errOut(errors);
+  if (!lld::elf::link(argv, llvm::nulls(), errOut, false, false)) {
+    return makeError("linking failed: " + llvm::StringRef(errOut.str()).rtrim());
+  }
+  return llvm::Error::success();
+}
+#endif
+
+} // namespace
+
+#ifdef FERN_HAS_LLD
+MemoryFile::MemoryFile(MemoryFile &&other) noexcept : fd(std::exchange(other.fd, -1)) {}
+
+MemoryFile::~MemoryFile() {
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+auto MemoryFile::write(llvm::StringRef contents) -> llvm::Error {
+  fd = memfd_create("fern", MFD_CLOEXEC);
+  if (fd < 0) {
+    return makeError("could not create an in-memory object file: " +
+                     std::error_code(errno, std::generic_category()).message());
+  }
+
+  llvm::raw_fd_ostream out(fd, false);
+  out << contents;
+  out.flush();
+  if (out.has_error()) {
+    auto ec = out.error();
+    out.clear_error();
+    return makeError("could not write an in-memory object file: " + ec.message());
+  }
+  return llvm::Error::success();
+}
+
+auto MemoryFile::getPath() const -> std::string {
+  return "/proc/self/fd/" + std::to_string(fd);
+}
+#endif
+
+auto linksInProcess(const llvm::Triple &target, const std::vector<std::string> &linkArgs)
+    -> bool {
+#ifdef FERN_HAS_LLD
+  // the C runtime fern was configured with is the host's. C sources need a compiler
+  llvm::Triple host(llvm::sys::getProcessTriple());
+  return target.isOSBinFormatELF() && target.getArch() == host.getArch() &&
+         target.getOS() == host.getOS() && hostInterpreter() &&
+         llvm::none_of(linkArgs, [](auto &arg) { return llvm::StringRef(arg).endswith(".c"); });
+#else
+  (void)target;
+  (void)linkArgs;
+  return false;
+#endif
+}
+
+auto linkObjects(const std::vector<std::string> &objects, EmitKind kind,
+                 const std::string &path, const llvm::Triple &target) -> llvm::Error {
+#ifdef FERN_HAS_LLD
+  if (kind == EmitKind::Executable && linksInProcess(target, objects)) {
+    return linkWithLLD(objects, path);
+  }
+#else
+  (void)target;
+#endif
+
+  auto cc = llvm::sys::findProgramByName("cc");
+  if (!cc) {
+    return makeError("could not find `cc` to link with: " + cc.getError().message());
+  }
+
+  std::vector<llvm::StringRef> args{*cc};
+  if (kind == EmitKind::Object) {
+    args.insert(args.end(), {"-r", "-nostdlib"});
+  }
+  args.insert(args.end(), objects.begin(), objects.end());
+  args.insert(args.end(), {"-o", path});
+
+  std::string errMsg;
+  if (llvm::sys::ExecuteAndWait(*cc, args, llvm::None, {}, 0, 0, &errMsg) != 0) {
+    return makeError("linking failed" + (errMsg.empty() ? "" : ": " + errMsg));
+  }
+  return llvm::Error::success();
+}
+
+auto parseEmitKind(std::string_view kind) -> std::optional<EmitKind> {
+  if (kind == "ll") {
+    return EmitKind::IR;
+  } else if (kind == "bc") {
+    return EmitKind::Bitcode;
+  } else if (kind == "asm") {
+    return EmitKind::Assembly;
+  } else if (kind == "obj") {
+    return EmitKind::Object;
+  } else if (kind == "exe") {
+    return EmitKind::Executable;
+  }
+  return std::nullopt;
+}
+
+auto defaultOutputPath(std::string_view input, EmitKind kind) -> std::string {
+  auto stem = llvm::sys::path::stem(llvm::StringRef(input.data(), input.size())).str();
+  switch (kind) {
+  case EmitKind::IR:
+    return stem + ".ll";
+  case EmitKind::Bitcode:
+    return stem + ".bc";
+  case EmitKind::Assembly:
+    return stem + ".s";
+  case EmitKind::Object:
+    return stem + ".o";
+  case EmitKind::Executable:
+    return stem;
+  }
+  return stem;
+}
+
+auto emitModule(llvm::Module &module, llvm::TargetMachine &targetMachine, EmitKind kind,
+                const std::string &path, const std::vector<std::string> &linkArgs)
+    -> llvm::Error {
+  switch (kind) {
+  case EmitKind::IR:
+  case EmitKind::Bitcode: {
+    std::error_code ec;
+    llvm::raw_fd_ostream out(path, ec,
+                             kind == EmitKind::IR ? llvm::sys::fs::OF_Text
+                                                  : llvm::sys::fs::OF_None);
+    if (ec) {
+      return makeError("could not open " + path + ": " + ec.message());
+    }
+
+    if (kind == EmitKind::IR) {
+      module.print(out, nullptr);
+    } else {
+      llvm::WriteBitcodeToFile(module, out);
+    }
+    return closeOutput(out, path);
+  }
+  case EmitKind::Assembly:
+    return emitMachineCode(module, targetMachine, llvm::CGFT_AssemblyFile, path);
+  case EmitKind::Object:
+    return emitMachineCode(module, targetMachine, llvm::CGFT_ObjectFile, path);
+  case EmitKind::Executable:
+    break;
+  }
+
+  auto &target = targetMachine.getTargetTriple();
+#ifdef FERN_HAS_LLD
+  if (linksInProcess(target, linkArgs)) {
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream out(buffer);
+    llvm::legacy::PassManager pm;
+    if (targetMachine.addPassesToEmitFile(pm, out, nullptr, llvm::CGFT_ObjectFile)) {
+      return makeError("the target can't emit this file type");
+    }
+    pm.run(module);
+
+    MemoryFile object;
+    if (auto err = object.write(llvm::StringRef(buffer.data(), buffer.size()))) {
+      return err;
+    }
+    std::vector<std::string> inputs{object.getPath()};
+    inputs.insert(inputs.end(), linkArgs.begin(), linkArgs.end());
+    return linkObjects(inputs, EmitKind::Executable, path, target);
+  }
+#endif
+
+  llvm::SmallString<128> object;
+  if (auto ec = llvm::sys::fs::createTemporaryFile("fern", "o", object)) {
+    return makeError("could not create a temporary object file: " + ec.message());
+  }
+
+  auto err = emitMachineCode(module, targetMachine, llvm::CGFT_ObjectFile, object.str().str());
+  if (!err) {
+    std::vector<std::string> inputs{object.str().str()};
+    inputs.insert(inputs.end(), linkArgs.begin(), linkArgs.end());
+    err = linkObjects(inputs, EmitKind::Executable, path, target);
+  }
+  llvm::sys::fs::remove(object);
+  return err;
+}
+
+} // namespace fern
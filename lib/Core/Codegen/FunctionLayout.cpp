@@ -0,0 +1,71 @@
+#include "Codegen/FunctionLayout.hpp"
+#include <algorithm>
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace fern {
+
+auto layoutFunctions(llvm::Module &module) -> std::vector<HotFunction> {
+  llvm::ProfileSummaryInfo psi(module);
+
+  std::vector<std::pair<llvm::Function *, u64>> hot;
+  std::vector<llvm::Function *> cold;
+  for (auto &func: module) {
+    if (func.isDeclaration()) {
+      continue;
+    }
+
+    auto entryCount = func.getEntryCount();
+    if (func.hasFnAttribute(llvm::Attribute::Hot) || psi.isFunctionEntryHot(&func)) {
+      func.setSectionPrefix("hot");
+      hot.emplace_back(&func, entryCount ? entryCount->getCount() : 0);
+    } else if (psi.isFunctionEntryCold(&func)) {
+      func.setSectionPrefix("unlikely");
+      cold.push_back(&func);
+    }
+  }
+
+  std::stable_sort(hot.begin(), hot.end(), [](auto &a, auto &b) { return a.second > b.second; });
+
+  // functions are emitted in module order within a section
+  auto &functions = module.getFunctionList();
+  for (auto it = hot.rbegin(); it != hot.rend(); ++it) {
+    functions.splice(functions.begin(), functions, it->first->getIterator());
+  }
+  for (auto func: cold) {
+    functions.splice(functions.end(), functions, func->getIterator());
+  }
+
+  std::vector<HotFunction> order;
+  for (auto &[func, count]: hot) {
+    order.push_back(HotFunction{func->getName().str(), count});
+  }
+  return order;
+}
+
+auto writeSymbolOrder(std::vector<HotFunction> functions, const std::string &path)
+    -> llvm::Error {
+  std::stable_sort(functions.begin(), functions.end(),
+                   [](auto &a, auto &b) { return a.entryCount > b.entryCount; });
+
+  std::error_code ec;
+  llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    return llvm::createStringError(ec, "could not open " + path + ": " + ec.message());
+  }
+  for (auto &func: functions) {
+    out << func.name << "\n";
+  }
+
+  out.close();
+  if (out.has_error()) {
+    ec = out.error();
+    out.clear_error();
+    return llvm::createStringError(ec, "could not write " + path + ": " + ec.message());
+  }
+  return llvm::Error::success();
+}
+
+} // namespace fern
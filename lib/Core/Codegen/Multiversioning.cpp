@@ -0,0 +1,178 @@
+#include "Codegen/Multiversioning.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+namespace fern {
+
+namespace {
+
+struct CPUFeature {
+  const char *name;
+  u32 bit;      // in libgcc's and compiler-rt's `__cpu_model`/`__cpu_features2`
+  u32 priority; // clones with higher priority are tried first
+};
+
+// bits are in declaration order, like the runtime's `enum ProcessorFeatures`
+const std::vector<CPUFeature> &cpuFeatures() {
+  static const std::vector<CPUFeature> features = [] {
+    std::vector<CPUFeature> list;
+#define X86_FEATURE_COMPAT(ENUM, STR, PRIORITY)                                                \
+  list.push_back(CPUFeature{STR, static_cast<u32>(list.size()), PRIORITY});
+#include "llvm/Support/X86TargetParser.def"
+    return list;
+  }();
+  return features;
+}
+
+auto findFeature(llvm::StringRef name) -> const CPUFeature * {
+  for (auto &feature: cpuFeatures()) {
+    if (name == feature.name) {
+      return &feature;
+    }
+  }
+  return nullptr;
+}
+
+auto makeError(const llvm::Twine &message) -> llvm::Error {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), message);
+}
+
+auto withFeature(llvm::Function &func, llvm::StringRef feature) -> void {
+  auto features = func.getFnAttribute("target-features").getValueAsString().str();
+  func.addFnAttr("target-features", (features.empty() ? "" : features + ",") + "+" + feature.str());
+}
+
+// the runtime fills `__cpu_model` lazily, and resolvers run before constructors do
+auto buildResolver(llvm::Module &module, llvm::Function &defaultFunc,
+                   const std::vector<std::pair<const CPUFeature *, llvm::Function *>> &clones,
+                   const std::string &name) -> llvm::Function * {
+  auto &llvmCtx = module.getContext();
+  auto i32 = llvm::Type::getInt32Ty(llvmCtx);
+  auto voidType = llvm::Type::getVoidTy(llvmCtx);
+
+  auto init = module.getOrInsertFunction("__cpu_indicator_init",
+                                         llvm::FunctionType::get(voidType, false));
+  auto cpuModelType = llvm::StructType::get(llvmCtx, {i32, i32, i32, llvm::ArrayType::get(i32, 1)});
+  auto cpuModel = module.getOrInsertGlobal("__cpu_model", cpuModelType);
+  auto cpuFeatures2 = module.getOrInsertGlobal("__cpu_features2", i32);
+
+  auto resolver = llvm::Function::Create(
+      llvm::FunctionType::get(defaultFunc.getType(), false), llvm::Function::InternalLinkage,
+      name + ".resolver", module);
+  llvm::IRBuilder<> builder(llvm::BasicBlock::Create(llvmCtx, "entry", resolver));
+  builder.CreateCall(init);
+
+  llvm::Value *features = builder.CreateLoad(
+      i32, builder.CreateConstInBoundsGEP2_32(cpuModelType, cpuModel, 3, 0), "features");
+  llvm::Value *features2 = nullptr;
+  for (auto [feature, clone]: clones) {
+    auto word = features;
+    if (feature->bit >= 32) {
+      if (!features2) {
+        features2 = builder.CreateLoad(i32, cpuFeatures2, "features2");
+      }
+      word = features2;
+    }
+
+    auto mask = builder.getInt32(1u << (feature->bit % 32));
+    auto supported = builder.CreateICmpNE(builder.CreateAnd(word, mask), builder.getInt32(0));
+    auto then = llvm::BasicBlock::Create(llvmCtx, feature->name, resolver);
+    auto next = llvm::BasicBlock::Create(llvmCtx, "next", resolver);
+    builder.CreateCondBr(supported, then, next);
+
+    builder.SetInsertPoint(then);
+    builder.CreateRet(clone);
+    builder.SetInsertPoint(next);
+  }
+  builder.CreateRet(&defaultFunc);
+  return resolver;
+}
+
+} // namespace
+
+auto emitTargetClones(llvm::Module &module, CloneDispatch dispatch) -> llvm::Expected<usize> {
+  std::vector<llvm::Function *> annotated;
+  for (auto &func: module) {
+    if (!func.isDeclaration() && func.hasFnAttribute(targetClonesAttr)) {
+      annotated.push_back(&func);
+    }
+  }
+
+  llvm::StringMap<bool> hostFeatures;
+  if (dispatch == CloneDispatch::Host && !llvm::sys::getHostCPUFeatures(hostFeatures)) {
+    dispatch = CloneDispatch::Default;
+  }
+
+  for (auto func: annotated) {
+    auto list = func->getFnAttribute(targetClonesAttr).getValueAsString().str();
+    func->removeFnAttr(targetClonesAttr);
+
+    std::vector<const CPUFeature *> features;
+    llvm::SmallVector<llvm::StringRef, 4> names;
+    llvm::StringRef(list).split(names, ',', -1, false);
+    for (auto name: names) {
+      if (name == "default") {
+        continue;
+      }
+
+      auto feature = findFeature(name);
+      if (!feature) {
+        return makeError("unknown feature `" + name + "` in `@target_clones` on `" +
+                         func->getName() + "`");
+      }
+      features.push_back(feature);
+    }
+    std::stable_sort(features.begin(), features.end(),
+                     [](auto a, auto b) { return a->priority > b->priority; });
+
+    if (dispatch == CloneDispatch::Default) {
+      continue;
+    }
+
+    // the JIT runs where it compiles, so the best supported clone can be picked now
+    if (dispatch == CloneDispatch::Host) {
+      auto best = std::find_if(features.begin(), features.end(), [&](auto feature) {
+        return hostFeatures.lookup(feature->name);
+      });
+      if (best != features.end()) {
+        withFeature(*func, (*best)->name);
+      }
+      continue;
+    }
+
+    auto name = func->getName().str();
+    std::vector<std::pair<const CPUFeature *, llvm::Function *>> clones;
+    for (auto feature: features) {
+      llvm::ValueToValueMapTy vmap;
+      auto clone = llvm::CloneFunction(func, vmap);
+      clone->setName(name + "." + feature->name);
+      clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+      withFeature(*clone, feature->name);
+      clones.emplace_back(feature, clone);
+    }
+
+    auto linkage = func->getLinkage();
+    func->setName(name + ".default");
+    func->setLinkage(llvm::GlobalValue::InternalLinkage);
+    auto resolver = buildResolver(module, *func, clones, name);
+    auto ifunc = llvm::GlobalIFunc::create(func->getFunctionType(), func->getAddressSpace(),
+                                           linkage, name, resolver, &module);
+
+    // callers, including recursive calls in the clones, go through the ifunc
+    func->replaceUsesWithIf(ifunc, [&](llvm::Use &use) {
+      auto inst = llvm::dyn_cast<llvm::Instruction>(use.getUser());
+      return !inst || inst->getFunction() != resolver;
+    });
+  }
+
+  return annotated.size();
+}
+
+} // namespace fern
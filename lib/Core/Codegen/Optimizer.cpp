@@ -0,0 +1,147 @@
+#include "Codegen/Optimizer.hpp"
+#include <vector>
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Transforms/IPO/HotColdSplitting.h"
+
+namespace fern {
+
+namespace {
+
+// set by codegen from `@optimize(level)`
+constexpr const char *optLevelAttr = "fern-opt-level";
+
+auto toLLVM(OptLevel level) -> llvm::OptimizationLevel {
+  switch (level) {
+  case OptLevel::O0:
+    return llvm::OptimizationLevel::O0;
+  case OptLevel::O1:
+    return llvm::OptimizationLevel::O1;
+  case OptLevel::O2:
+    return llvm::OptimizationLevel::O2;
+  case OptLevel::O3:
+    return llvm::OptimizationLevel::O3;
+  case OptLevel::Os:
+    return llvm::OptimizationLevel::Os;
+  case OptLevel::Oz:
+    return llvm::OptimizationLevel::Oz;
+  }
+  return llvm::OptimizationLevel::O0;
+}
+
+auto addSizeAttrs(llvm::Function &func, OptLevel level) -> void {
+  if (level == OptLevel::Os || level == OptLevel::Oz) {
+    func.addFnAttr(llvm::Attribute::OptimizeForSize);
+  }
+  if (level == OptLevel::Oz) {
+    func.addFnAttr(llvm::Attribute::MinSize);
+  }
+}
+
+struct Override {
+  llvm::Function *func;
+  OptLevel level;
+  bool addedNoInline;
+};
+
+} // namespace
+
+auto Optimizer::run(llvm::Module &module) -> llvm::Error {
+  // the O0 pipeline only runs the always-inliner, which codegen never gives work
+  // to, so without overrides or instrumentation the module can go straight to the
+  // backend
+  bool instrumenting = profile.mode == ProfileOptions::Mode::Generate;
+  if (pipeline.empty() && level == OptLevel::O0 && !instrumenting &&
+      llvm::none_of(module, [](auto &func) { return func.hasFnAttribute(optLevelAttr); })) {
+    return llvm::Error::success();
+  }
+
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+
+  llvm::Optional<llvm::PGOOptions> pgo;
+  if (profile.mode == ProfileOptions::Mode::Generate) {
+    pgo = llvm::PGOOptions(profile.path, "", "", llvm::PGOOptions::IRInstr);
+  } else if (profile.mode == ProfileOptions::Mode::Use) {
+    pgo = llvm::PGOOptions(profile.path, "", "", llvm::PGOOptions::IRUse);
+  }
+
+  llvm::PassBuilder pb(targetMachine, llvm::PipelineTuningOptions(), pgo);
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+  // the default pipelines leave hot/cold splitting off. it's only worth it at the
+  // speed levels when something is known to be cold, from a profile or `@cold`
+  bool coldKnown = profile.mode == ProfileOptions::Mode::Use ||
+                   llvm::any_of(module, [](auto &func) {
+                     return func.hasFnAttribute(llvm::Attribute::Cold);
+                   });
+  if (coldKnown && (level == OptLevel::O2 || level == OptLevel::O3)) {
+    pb.registerOptimizerLastEPCallback([](llvm::ModulePassManager &mpm, auto) {
+      mpm.addPass(llvm::HotColdSplittingPass());
+    });
+  }
+
+  llvm::ModulePassManager mpm;
+  if (!pipeline.empty()) {
+    if (auto err = pb.parsePassPipeline(mpm, pipeline)) {
+      return err;
+    }
+  } else if (level == OptLevel::O0) {
+    mpm = pb.buildO0DefaultPipeline(llvm::OptimizationLevel::O0, thinLTOPreLink);
+  } else if (thinLTOPreLink) {
+    mpm = pb.buildThinLTOPreLinkDefaultPipeline(toLLVM(level));
+  } else {
+    mpm = pb.buildPerModuleDefaultPipeline(toLLVM(level));
+  }
+
+  // overridden functions sit out the module pipeline as optnone
+  std::vector<Override> overrides;
+  for (auto &func: module) {
+    if (func.isDeclaration()) {
+      continue;
+    }
+
+    auto attr = func.getFnAttribute(optLevelAttr);
+    if (!attr.isValid()) {
+      addSizeAttrs(func, level);
+      continue;
+    }
+
+    auto funcLevel = parseOptLevel(attr.getValueAsString()).value_or(level);
+    func.removeFnAttr(optLevelAttr);
+    overrides.push_back(Override{&func, funcLevel, !func.hasFnAttribute(llvm::Attribute::NoInline)});
+    func.addFnAttr(llvm::Attribute::OptimizeNone);
+    func.addFnAttr(llvm::Attribute::NoInline);
+  }
+
+  mpm.run(module, mam);
+
+  for (auto &override: overrides) {
+    if (override.level == OptLevel::O0) {
+      continue;
+    }
+
+    auto &func = *override.func;
+    func.removeFnAttr(llvm::Attribute::OptimizeNone);
+    if (override.addedNoInline) {
+      func.removeFnAttr(llvm::Attribute::NoInline);
+    }
+    addSizeAttrs(func, override.level);
+
+    fam.invalidate(func, llvm::PreservedAnalyses::none());
+    auto fpm = pb.buildFunctionSimplificationPipeline(toLLVM(override.level),
+                                                      llvm::ThinOrFullLTOPhase::None);
+    fpm.run(func, fam);
+  }
+
+  return llvm::Error::success();
+}
+
+} // namespace fern
@@ -0,0 +1,278 @@
+#include "Codegen/ParallelBackend.hpp"
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include "Codegen/FunctionLayout.hpp"
+#include "Codegen/Optimizer.hpp"
+#include "Codegen/Remarks.hpp"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Target/TargetMachine.h"
+
+namespace fern {
+
+namespace {
+
+// callees up to this many instructions are copied into the partitions calling them
+constexpr usize importLimit = 64;
+
+struct Partitioning {
+  std::unordered_map<std::string, u32> owner;
+  std::vector<std::set<std::string>> imports;
+};
+
+auto partition(llvm::Module &module, u32 count, bool importCallees) -> Partitioning {
+  std::vector<llvm::Function *> defined;
+  for (auto &func: module) {
+    if (!func.isDeclaration()) {
+      defined.push_back(&func);
+    }
+  }
+
+  // largest first onto the least loaded partition, ties going to the lowest index
+  std::stable_sort(defined.begin(), defined.end(), [](auto a, auto b) {
+    return a->getInstructionCount() > b->getInstructionCount();
+  });
+
+  Partitioning parts;
+  parts.imports.resize(count);
+  std::vector<usize> load(count, 0);
+  for (auto func: defined) {
+    auto lightest = std::min_element(load.begin(), load.end()) - load.begin();
+    parts.owner[func->getName().str()] = lightest;
+    load[lightest] += func->getInstructionCount();
+  }
+
+  if (!importCallees) {
+    return parts;
+  }
+
+  for (auto func: defined) {
+    auto owner = parts.owner[func->getName().str()];
+    for (auto &inst: llvm::instructions(*func)) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+      auto callee = call ? call->getCalledFunction() : nullptr;
+      if (!callee || callee->isDeclaration() || callee->getInstructionCount() > importLimit) {
+        continue;
+      }
+
+      auto name = callee->getName().str();
+      if (parts.owner[name] != owner) {
+        parts.imports[owner].insert(name);
+      }
+    }
+  }
+  return parts;
+}
+
+// codegen keeps state in the target machine, so every thread needs its own
+auto cloneTargetMachine(const llvm::TargetMachine &targetMachine)
+    -> std::unique_ptr<llvm::TargetMachine> {
+  return std::unique_ptr<llvm::TargetMachine>(targetMachine.getTarget().createTargetMachine(
+      targetMachine.getTargetTriple().str(), targetMachine.getTargetCPU(),
+      targetMachine.getTargetFeatureString(), targetMachine.Options,
+      targetMachine.getRelocationModel(), targetMachine.getCodeModel(),
+      targetMachine.getOptLevel()));
+}
+
+auto compilePartition(llvm::StringRef bitcode, u32 index, const Partitioning &parts,
+                      OptLevel level, const std::string &pipeline, const ProfileOptions &profile,
+                      const llvm::TargetMachine &targetMachine, RemarkCollector *remarks,
+                      const std::string &object, std::vector<HotFunction> &hot)
+    -> llvm::Error {
+  llvm::LLVMContext llvmCtx;
+  if (remarks) {
+    remarks->install(llvmCtx);
+  }
+  auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, "partition"), llvmCtx);
+  if (!module) {
+    return module.takeError();
+  }
+
+  for (auto &func: **module) {
+    if (func.isDeclaration()) {
+      continue;
+    }
+
+    auto name = func.getName().str();
+    if (parts.owner.at(name) == index) {
+      continue;
+    }
+    if (parts.imports[index].count(name)) {
+      func.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+    } else {
+      func.deleteBody();
+    }
+  }
+
+  for (auto &global: llvm::make_early_inc_range((*module)->globals())) {
+    if (global.isDeclaration()) {
+      continue;
+    }
+
+    // exported data is defined by the first partition only
+    if (!global.hasLocalLinkage() && index != 0) {
+      global.setInitializer(nullptr);
+      global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+      global.setComdat(nullptr);
+      continue;
+    }
+
+    global.removeDeadConstantUsers();
+    if (global.hasLocalLinkage() && global.use_empty()) {
+      global.eraseFromParent();
+    }
+  }
+
+  // `@target_clones` dispatchers live with their resolver, everyone else calls them
+  for (auto &ifunc: llvm::make_early_inc_range((*module)->ifuncs())) {
+    if (parts.owner.at(ifunc.getResolverFunction()->getName().str()) == index) {
+      continue;
+    }
+
+    auto decl = llvm::Function::Create(llvm::cast<llvm::FunctionType>(ifunc.getValueType()),
+                                       llvm::GlobalValue::ExternalLinkage, "", **module);
+    decl->takeName(&ifunc);
+    ifunc.replaceAllUsesWith(decl);
+    ifunc.eraseFromParent();
+  }
+
+  auto partitionMachine = cloneTargetMachine(targetMachine);
+  if (!partitionMachine) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "could not create a target machine for a partition");
+  }
+
+  Optimizer optimizer(level, pipeline, partitionMachine.get());
+  optimizer.setProfile(profile);
+  if (auto err = optimizer.run(**module)) {
+    return err;
+  }
+  hot = layoutFunctions(**module);
+  return emitModule(**module, *partitionMachine, EmitKind::Object, object);
+}
+
+} // namespace
+
+auto ParallelBackend::run(llvm::Module &module, EmitKind kind, const std::string &path)
+    -> llvm::Error {
+  usize defined = 0;
+  for (auto &func: module) {
+    defined += !func.isDeclaration();
+  }
+
+  u32 count = std::min<usize>(jobs, defined);
+  if (count <= 1) {
+    Optimizer optimizer(level, pipeline, &targetMachine);
+    optimizer.setProfile(profile);
+    if (auto err = optimizer.run(module)) {
+      return err;
+    }
+    auto hot = layoutFunctions(module);
+    if (!symbolOrder.empty()) {
+      if (auto err = writeSymbolOrder(std::move(hot), symbolOrder)) {
+        return err;
+      }
+    }
+    return emitModule(module, targetMachine, kind, path, linkArgs);
+  }
+
+  // partitions can only call each other's functions if they're visible to the linker.
+  // profiles name local functions after the file, so they keep that name to stay
+  // interchangeable with serial builds
+  for (auto &func: module) {
+    if (!func.isDeclaration() && func.hasLocalLinkage()) {
+      if (profile.mode != ProfileOptions::Mode::None) {
+        func.setName(llvm::getPGOFuncName(func));
+      }
+      func.setLinkage(llvm::GlobalValue::ExternalLinkage);
+      func.setVisibility(llvm::GlobalValue::HiddenVisibility);
+    }
+  }
+  for (auto &ifunc: module.ifuncs()) {
+    if (ifunc.hasLocalLinkage()) {
+      ifunc.setLinkage(llvm::GlobalValue::ExternalLinkage);
+      ifunc.setVisibility(llvm::GlobalValue::HiddenVisibility);
+    }
+  }
+
+  // nothing is inlined at O0, so there's no point in copying callees around. copies
+  // would also be counted twice by instrumentation
+  auto parts = partition(module, count,
+                         level != OptLevel::O0 &&
+                             profile.mode != ProfileOptions::Mode::Generate);
+
+  llvm::SmallVector<char, 0> bitcode;
+  {
+    llvm::raw_svector_ostream out(bitcode);
+    llvm::WriteBitcodeToFile(module, out);
+  }
+
+  std::vector<std::string> objects;
+  auto cleanup = [&] {
+    for (auto &object: objects) {
+      llvm::sys::fs::remove(object);
+    }
+  };
+  for (u32 i = 0; i < count; ++i) {
+    llvm::SmallString<128> object;
+    if (auto ec = llvm::sys::fs::createTemporaryFile("fern", "o", object)) {
+      cleanup();
+      return llvm::createStringError(ec, "could not create a temporary object file: " +
+                                             ec.message());
+    }
+    objects.push_back(object.str().str());
+  }
+
+  std::vector<std::string> errors(count);
+  std::vector<std::vector<HotFunction>> hot(count);
+  {
+    llvm::ThreadPool pool(llvm::hardware_concurrency(count));
+    for (u32 i = 0; i < count; ++i) {
+      pool.async([&, i] {
+        if (auto err = compilePartition(llvm::StringRef(bitcode.data(), bitcode.size()), i,
+                                        parts, level, pipeline, profile, targetMachine,
+                                        remarks, objects[i], hot[i])) {
+          errors[i] = llvm::toString(std::move(err));
+        }
+      });
+    }
+    pool.wait();
+  }
+
+  for (auto &error: errors) {
+    if (!error.empty()) {
+      cleanup();
+      return llvm::createStringError(llvm::inconvertibleErrorCode(), error);
+    }
+  }
+
+  if (!symbolOrder.empty()) {
+    std::vector<HotFunction> merged;
+    for (auto &part: hot) {
+      merged.insert(merged.end(), part.begin(), part.end());
+    }
+    if (auto err = writeSymbolOrder(std::move(merged), symbolOrder)) {
+      cleanup();
+      return err;
+    }
+  }
+
+  auto inputs = objects;
+  if (kind == EmitKind::Executable) {
+    inputs.insert(inputs.end(), linkArgs.begin(), linkArgs.end());
+  }
+  auto err = linkObjects(inputs, kind, path, targetMachine.getTargetTriple());
+  cleanup();
+  return err;
+}
+
+} // namespace fern
@@ -0,0 +1,98 @@
+#include "Codegen/ProfileRuntime.hpp"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace fern {
+
+namespace {
+
+// the raw format is version 8: a header, the data records, the counters they point
+// at relative to themselves, then the (possibly compressed) function names. the
+// sections are found through the linker's `__start_`/`__stop_` symbols, as on ELF
+// the instrumented code doesn't register anything
+constexpr const char *runtimeSource = R"(#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SECTION_BOUNDS(name)                                                   \
+  extern char __start_##name[] __attribute__((weak, visibility("hidden")));    \
+  extern char __stop_##name[] __attribute__((weak, visibility("hidden")));
+SECTION_BOUNDS(__llvm_prf_data)
+SECTION_BOUNDS(__llvm_prf_cnts)
+SECTION_BOUNDS(__llvm_prf_names)
+
+extern uint64_t __llvm_profile_raw_version __attribute__((weak));
+extern const char __llvm_profile_filename[] __attribute__((weak));
+
+/* referenced by every instrumented object to pull the runtime in */
+int __llvm_profile_runtime;
+
+void __llvm_profile_instrument_target(uint64_t value, void *data, uint32_t site) {}
+void __llvm_profile_instrument_memop(uint64_t value, void *data, uint32_t site) {}
+
+static void fernWriteProfile(void) {
+  const char *path = getenv("LLVM_PROFILE_FILE");
+  if (!path || !*path) {
+    path = __llvm_profile_filename && *__llvm_profile_filename ? __llvm_profile_filename
+                                                               : "default.profraw";
+  }
+
+  FILE *out = fopen(path, "wb");
+  if (!out) {
+    fprintf(stderr, "fern: could not write profile to %s\n", path);
+    return;
+  }
+
+  uint64_t dataSize = __stop___llvm_prf_data - __start___llvm_prf_data;
+  uint64_t countersSize = __stop___llvm_prf_cnts - __start___llvm_prf_cnts;
+  uint64_t namesSize = __stop___llvm_prf_names - __start___llvm_prf_names;
+  uint64_t header[] = {
+    MAGIC,
+    &__llvm_profile_raw_version ? __llvm_profile_raw_version : VERSION,
+    0, /* binary ids */
+    dataSize / DATA_RECORD_SIZE,
+    0,
+    countersSize / sizeof(uint64_t),
+    0,
+    namesSize,
+    (uint64_t)(uintptr_t)__start___llvm_prf_cnts - (uint64_t)(uintptr_t)__start___llvm_prf_data,
+    (uint64_t)(uintptr_t)__start___llvm_prf_names,
+    VALUE_KIND_LAST,
+  };
+  static const char padding[8];
+
+  fwrite(header, sizeof(header), 1, out);
+  fwrite(__start___llvm_prf_data, 1, dataSize, out);
+  fwrite(__start___llvm_prf_cnts, 1, countersSize, out);
+  fwrite(__start___llvm_prf_names, 1, namesSize, out);
+  fwrite(padding, 1, (8 - namesSize % 8) % 8, out);
+  fclose(out);
+}
+
+__attribute__((constructor)) static void fernRegisterProfileWriter(void) {
+  atexit(fernWriteProfile);
+}
+)";
+
+} // namespace
+
+auto writeProfileRuntime() -> llvm::Expected<std::string> {
+  llvm::SmallString<128> path;
+  int fd;
+  if (auto ec = llvm::sys::fs::createTemporaryFile("fern-profile", "c", fd, path)) {
+    return llvm::createStringError(ec, "could not create the profile runtime: " + ec.message());
+  }
+
+  // the layout constants come from the LLVM the instrumentation was built with
+  llvm::raw_fd_ostream out(fd, true);
+  out << "#define MAGIC " << llvm::RawInstrProf::getMagic<uint64_t>() << "ULL\n";
+  out << "#define VERSION " << llvm::RawInstrProf::Version << "ULL\n";
+  out << "#define DATA_RECORD_SIZE " << sizeof(llvm::RawInstrProf::ProfileData<uint64_t>)
+      << "\n";
+  out << "#define VALUE_KIND_LAST " << llvm::IPVK_Last << "\n";
+  out << runtimeSource;
+  return path.str().str();
+}
+
+} // namespace fern
@@ -0,0 +1,206 @@
+#include "Codegen/Remarks.hpp"
+#include <algorithm>
+#include <iostream>
+#include "Errors/FancyPrinter.hpp"
+#include "llvm/IR/DiagnosticHandler.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Remarks/Remark.h"
+#include "llvm/Remarks/RemarkSerializer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+namespace fern {
+
+namespace {
+
+class RemarkHandler : public llvm::DiagnosticHandler {
+  RemarkCollector &collector;
+
+public:
+  RemarkHandler(RemarkCollector &collector) : collector(collector) {}
+
+  auto isAnalysisRemarkEnabled(llvm::StringRef pass) const -> bool override {
+    return collector.isEnabled(RemarkKind::Analysis, pass);
+  }
+  auto isMissedOptRemarkEnabled(llvm::StringRef pass) const -> bool override {
+    return collector.isEnabled(RemarkKind::Missed, pass);
+  }
+  auto isPassedOptRemarkEnabled(llvm::StringRef pass) const -> bool override {
+    return collector.isEnabled(RemarkKind::Passed, pass);
+  }
+  auto isAnyRemarkEnabled() const -> bool override { return true; }
+
+  // everything that isn't a remark gets LLVM's default printing
+  auto handleDiagnostics(const llvm::DiagnosticInfo &info) -> bool override {
+    auto remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&info);
+    if (!remark) {
+      return false;
+    }
+    if (remark->isEnabled()) {
+      collector.add(*remark);
+    }
+    return true;
+  }
+};
+
+auto toRemarkType(RemarkKind kind) -> llvm::remarks::Type {
+  switch (kind) {
+  case RemarkKind::Passed:
+    return llvm::remarks::Type::Passed;
+  case RemarkKind::Missed:
+    return llvm::remarks::Type::Missed;
+  case RemarkKind::Analysis:
+    return llvm::remarks::Type::Analysis;
+  }
+  return llvm::remarks::Type::Unknown;
+}
+
+} // namespace
+
+auto parseRemarkKind(std::string_view kind) -> std::optional<RemarkKind> {
+  if (kind == "passed") {
+    return RemarkKind::Passed;
+  } else if (kind == "missed") {
+    return RemarkKind::Missed;
+  } else if (kind == "analysis") {
+    return RemarkKind::Analysis;
+  }
+  return std::nullopt;
+}
+
+auto RemarkCollector::create(std::vector<RemarkKind> kinds, const std::string &filter)
+    -> llvm::Expected<std::unique_ptr<RemarkCollector>> {
+  std::optional<llvm::Regex> regex;
+  if (!filter.empty()) {
+    regex.emplace(filter);
+    std::string error;
+    if (!regex->isValid(error)) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "invalid remark filter `" + filter + "`: " + error);
+    }
+  }
+  return std::unique_ptr<RemarkCollector>(new RemarkCollector(std::move(kinds), std::move(regex)));
+}
+
+auto RemarkCollector::isEnabled(RemarkKind kind, llvm::StringRef pass) const -> bool {
+  if (std::find(kinds.begin(), kinds.end(), kind) == kinds.end()) {
+    return false;
+  }
+  return !filter || filter->match(pass);
+}
+
+auto RemarkCollector::install(llvm::LLVMContext &llvmCtx) -> void {
+  llvmCtx.setDiagnosticHandler(std::make_unique<RemarkHandler>(*this));
+  llvmCtx.setDiagnosticsHotnessRequested(hotness);
+}
+
+auto RemarkCollector::add(const llvm::DiagnosticInfoOptimizationBase &remark) -> void {
+  Record record;
+  record.kind = remark.isPassed()   ? RemarkKind::Passed
+                : remark.isMissed() ? RemarkKind::Missed
+                                    : RemarkKind::Analysis;
+  record.pass = remark.getPassName().str();
+  record.name = remark.getRemarkName().str();
+  record.function = remark.getFunction().getName().str();
+  record.message = remark.getMsg();
+  if (auto hotness = remark.getHotness()) {
+    record.hotness = *hotness;
+  }
+
+  // DWARF counts from 1, line 0 being merged or compiler generated code and column 0
+  // being unknown
+  if (remark.isLocationAvailable()) {
+    auto loc = remark.getLocation();
+    record.file = loc.getRelativePath().str();
+    if (loc.getLine() > 0) {
+      record.loc = SourceLocation(loc.getLine() - 1, std::max(loc.getColumn(), 1u) - 1);
+    }
+  }
+
+  for (auto &arg: remark.getArgs()) {
+    record.args.emplace_back(arg.Key, arg.Val);
+  }
+
+  std::lock_guard lock(mutex);
+  records.push_back(std::move(record));
+}
+
+auto RemarkCollector::sort() -> void {
+  std::stable_sort(records.begin(), records.end(), [](auto &a, auto &b) {
+    if (a.loc && b.loc) {
+      return std::make_pair(a.loc->getLine(), a.loc->getColumn()) <
+             std::make_pair(b.loc->getLine(), b.loc->getColumn());
+    }
+    return a.loc.has_value() && !b.loc.has_value();
+  });
+}
+
+auto RemarkCollector::print(const FancyErrorPrinter &printer) -> void {
+  std::lock_guard lock(mutex);
+  sort();
+
+  for (auto &record: records) {
+    auto message = fmt::format("{} [{}]", record.message, record.pass);
+    if (!record.loc) {
+      std::cerr << fmt::format("{}: remark: {}\n\n", record.function, message);
+      continue;
+    }
+
+    Error remark(message, *record.loc, Severity::Remark);
+    if (record.hotness) {
+      remark.addNote(fmt::format("`{}` ran {} times in the profile", record.function,
+                                 *record.hotness));
+    }
+    printer.print(remark);
+  }
+}
+
+auto RemarkCollector::serialize(const std::string &path, llvm::remarks::Format format)
+    -> llvm::Error {
+  std::error_code ec;
+  auto flags = format == llvm::remarks::Format::YAML ? llvm::sys::fs::OF_TextWithCRLF
+                                                     : llvm::sys::fs::OF_None;
+  llvm::ToolOutputFile out(path, ec, flags);
+  if (ec) {
+    return llvm::createStringError(ec, "could not open " + path + ": " + ec.message());
+  }
+
+  auto serializer = llvm::remarks::createRemarkSerializer(
+      format, llvm::remarks::SerializerMode::Standalone, out.os());
+  if (!serializer) {
+    return serializer.takeError();
+  }
+
+  std::lock_guard lock(mutex);
+  sort();
+
+  for (auto &record: records) {
+    llvm::remarks::Remark remark;
+    remark.RemarkType = toRemarkType(record.kind);
+    remark.PassName = record.pass;
+    remark.RemarkName = record.name;
+    remark.FunctionName = record.function;
+    if (record.loc) {
+      remark.Loc = llvm::remarks::RemarkLocation{record.file,
+                                                 static_cast<unsigned>(record.loc->getLine() + 1),
+                                                 static_cast<unsigned>(record.loc->getColumn() + 1)};
+    }
+    if (record.hotness) {
+      remark.Hotness = *record.hotness;
+    }
+    for (auto &[key, value]: record.args) {
+      llvm::remarks::Argument arg;
+      arg.Key = key;
+      arg.Val = value;
+      remark.Args.push_back(arg);
+    }
+    (*serializer)->emit(remark);
+  }
+
+  out.keep();
+  return llvm::Error::success();
+}
+
+} // namespace fern
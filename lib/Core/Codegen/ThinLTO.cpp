@@ -0,0 +1,291 @@
+#include "Codegen/ThinLTO.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include "Codegen/Emitter.hpp"
+#include "FernConfig.hpp"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/BinaryFormat/Magic.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Threading.h"
+
+namespace fern {
+
+namespace {
+
+auto makeError(const llvm::Twine &message) -> llvm::Error {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), message);
+}
+
+auto toCodeGenLevel(OptLevel level) -> llvm::CodeGenOpt::Level {
+  switch (level) {
+  case OptLevel::O0:
+    return llvm::CodeGenOpt::None;
+  case OptLevel::O1:
+    return llvm::CodeGenOpt::Less;
+  case OptLevel::O3:
+    return llvm::CodeGenOpt::Aggressive;
+  default:
+    return llvm::CodeGenOpt::Default;
+  }
+}
+
+// `Os` and `Oz` are attributes the pre-link pipeline already put on every function,
+// the LTO pipelines themselves only come in numbered levels
+auto toLTOLevel(OptLevel level) -> unsigned {
+  switch (level) {
+  case OptLevel::O0:
+    return 0;
+  case OptLevel::O1:
+    return 1;
+  case OptLevel::O3:
+    return 3;
+  default:
+    return 2;
+  }
+}
+
+// symbols objects outside of LTO refer to have to survive it. returns false when
+// `path` isn't an object file whose references can be read
+auto addUndefinedSymbols(llvm::StringRef path, std::set<std::string> &symbols) -> bool {
+  auto object = llvm::object::ObjectFile::createObjectFile(path);
+  if (!object) {
+    // C sources, libraries and anything else `cc` understands
+    llvm::consumeError(object.takeError());
+    return false;
+  }
+
+  for (auto &symbol: object->getBinary()->symbols()) {
+    auto flags = symbol.getFlags();
+    auto name = symbol.getName();
+    if (!flags || !name) {
+      llvm::consumeError(flags.takeError());
+      llvm::consumeError(name.takeError());
+      continue;
+    }
+    if (*flags & llvm::object::SymbolRef::SF_Undefined) {
+      symbols.insert(name->str());
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+auto writeThinLTOBitcode(llvm::Module &module, const std::string &path) -> llvm::Error {
+  llvm::ProfileSummaryInfo psi(module);
+  auto index = llvm::buildModuleSummaryIndex(module, nullptr, &psi);
+
+  std::error_code ec;
+  llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::OF_None);
+  if (ec) {
+    return makeError("could not open " + path + ": " + ec.message());
+  }
+  // the hash is what the link step caches the unit's object under
+  llvm::WriteBitcodeToFile(module, out, false, &index, true);
+
+  out.close();
+  if (out.has_error()) {
+    ec = out.error();
+    out.clear_error();
+    return makeError("could not write " + path + ": " + ec.message());
+  }
+  return llvm::Error::success();
+}
+
+auto ThinLTOLinker::defaultCacheDirectory() -> std::string {
+  auto prefix = std::getenv("FERN_PREFIX_DIR");
+  llvm::SmallString<128> path(prefix && *prefix ? prefix : FernPrefixDir);
+  llvm::sys::path::append(path, "cache", "thinlto");
+  return path.str().str();
+}
+
+auto ThinLTOLinker::run(const std::vector<std::string> &inputs, const std::string &path)
+    -> llvm::Error {
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> buffers;
+  std::vector<std::unique_ptr<llvm::lto::InputFile>> bitcode;
+  std::vector<std::string> passthrough;
+  std::set<std::string> regularRefs{"main"};
+  // set once an input can't be scanned, so any definition may be referenced from it
+  bool unscannedInputs = false;
+  for (auto &input: inputs) {
+    if (llvm::StringRef(input).startswith("-")) {
+      passthrough.push_back(input);
+      continue;
+    }
+
+    auto buffer = llvm::MemoryBuffer::getFile(input);
+    if (!buffer) {
+      return makeError("could not read " + input + ": " + buffer.getError().message());
+    }
+    if (llvm::identify_magic((*buffer)->getBuffer()) != llvm::file_magic::bitcode) {
+      unscannedInputs |= !addUndefinedSymbols(input, regularRefs);
+      passthrough.push_back(input);
+      continue;
+    }
+
+    auto file = llvm::lto::InputFile::create((*buffer)->getMemBufferRef());
+    if (!file) {
+      return makeError("could not load " + input + ": " + llvm::toString(file.takeError()));
+    }
+    buffers.push_back(std::move(*buffer));
+    bitcode.push_back(std::move(*file));
+  }
+
+  if (bitcode.empty()) {
+    return makeError("none of the inputs are ThinLTO bitcode, compile them with `--lto=thin`");
+  }
+  units = bitcode.size();
+
+  // units may have been compiled for any target with `--target`
+  llvm::InitializeAllTargetInfos();
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+  llvm::InitializeAllAsmPrinters();
+  llvm::InitializeAllAsmParsers();
+
+  // the target CPU and features are attributes on the functions
+  llvm::Triple triple(bitcode.front()->getTargetTriple());
+  llvm::lto::Config conf;
+  conf.RelocModel = llvm::Reloc::PIC_;
+  conf.OptLevel = toLTOLevel(level);
+  conf.CGOptLevel = toCodeGenLevel(level);
+  // see the embedded lld's `--gc-sections` and `--icf=safe`
+  bool inProcess = linksInProcess(triple, passthrough);
+  if (inProcess) {
+    conf.Options.FunctionSections = true;
+    conf.Options.DataSections = true;
+    conf.Options.EmitAddrsig = true;
+  }
+
+  auto backend =
+      llvm::lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency(jobs));
+  llvm::lto::LTO lto(std::move(conf), std::move(backend));
+
+  // the first definition wins, like it would for a linker, and everything defined
+  // here ends up in the executable
+  std::set<std::string> defined;
+  for (auto &file: bitcode) {
+    std::vector<llvm::lto::SymbolResolution> resolutions;
+    for (auto &symbol: file->symbols()) {
+      llvm::lto::SymbolResolution resolution;
+      auto name = symbol.getName().str();
+      if (!symbol.isUndefined() && defined.insert(name).second) {
+        resolution.Prevailing = true;
+        resolution.FinalDefinitionInLinkageUnit = true;
+      }
+      resolution.VisibleToRegularObj = symbol.isUsed() || regularRefs.count(name) ||
+                                       (unscannedInputs && resolution.Prevailing);
+      resolutions.push_back(resolution);
+    }
+
+    if (auto err = lto.add(std::move(file), resolutions)) {
+      return err;
+    }
+  }
+
+  std::vector<llvm::SmallString<0>> objects(lto.getMaxTasks());
+  llvm::AddStreamFn addStream = [&](unsigned task) {
+    return std::make_unique<llvm::CachedFileStream>(
+        std::make_unique<llvm::raw_svector_ostream>(objects[task]));
+  };
+
+  // misses are written to the cache and handed back through the same callback as hits
+  std::atomic<usize> hits = 0;
+  llvm::FileCache cache;
+  if (!cacheDir.empty()) {
+    auto addBuffer = [&](unsigned task, std::unique_ptr<llvm::MemoryBuffer> buffer) {
+      objects[task] = buffer->getBuffer();
+    };
+    auto created = llvm::localCache("ThinLTO", "fern-thinlto", cacheDir, addBuffer);
+    if (!created) {
+      return created.takeError();
+    }
+    cache = [&hits, local = std::move(*created)](unsigned task, llvm::StringRef key)
+        -> llvm::Expected<llvm::AddStreamFn> {
+      auto stream = local(task, key);
+      if (stream && !*stream) {
+        ++hits;
+      }
+      return stream;
+    };
+  }
+
+  if (auto err = lto.run(addStream, cache)) {
+    return err;
+  }
+  cacheHits = hits;
+
+  if (!cacheDir.empty()) {
+    llvm::CachePruningPolicy policy;
+    policy.Interval = std::chrono::seconds(0);
+    policy.MaxSizeBytes = cacheSize;
+    llvm::pruneCache(cacheDir, policy);
+  }
+
+  // LLD is handed the objects in memory, `cc` gets temporary files
+  std::vector<std::string> linkInputs;
+  std::vector<std::string> files;
+#ifdef FERN_HAS_LLD
+  std::vector<MemoryFile> memoryFiles;
+#endif
+  auto cleanup = [&] {
+    for (auto &file: files) {
+      llvm::sys::fs::remove(file);
+    }
+  };
+  for (auto &object: objects) {
+    if (object.empty()) {
+      continue;
+    }
+
+#ifdef FERN_HAS_LLD
+    if (inProcess) {
+      auto &memoryFile = memoryFiles.emplace_back();
+      if (auto err = memoryFile.write(object)) {
+        return err;
+      }
+      linkInputs.push_back(memoryFile.getPath());
+      continue;
+    }
+#endif
+
+    int fd;
+    llvm::SmallString<128> file;
+    if (auto ec = llvm::sys::fs::createTemporaryFile("fern", "o", fd, file)) {
+      cleanup();
+      return makeError("could not create a temporary object file: " + ec.message());
+    }
+    files.push_back(file.str().str());
+    linkInputs.push_back(file.str().str());
+
+    llvm::raw_fd_ostream out(fd, true);
+    out << object;
+    out.close();
+    if (out.has_error()) {
+      auto ec = out.error();
+      out.clear_error();
+      cleanup();
+      return makeError("could not write " + file.str() + ": " + ec.message());
+    }
+  }
+
+  linkInputs.insert(linkInputs.end(), passthrough.begin(), passthrough.end());
+  auto err = linkObjects(linkInputs, EmitKind::Executable, path, triple);
+  cleanup();
+  return err;
+}
+
+} // namespace fern
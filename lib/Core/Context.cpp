@@ -1,4 +1,8 @@
 #include "Errors/Context.hpp"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
 
 namespace fern {
 
@@ -10,6 +14,61 @@ auto Context::recordWarning(const std::string &message, SourceLocation loc) -> v
   warnings.push_back(Error(message, loc, true));
 }
 
+auto Context::initLLVM() -> void {
+  if (llvmContext) {
+    return;
+  }
+
+  llvmContext = std::make_unique<llvm::LLVMContext>();
+  builder = std::make_unique<llvm::IRBuilder<>>(*llvmContext);
+  llvmModule = std::make_unique<llvm::Module>("main", *llvmContext);
+  // names local functions in profiles
+  llvmModule->setSourceFileName(llvm::StringRef(filename.data(), filename.size()));
+}
+
+auto Context::getTargetMachine() -> llvm::Expected<llvm::TargetMachine &> {
+  if (targetMachine) {
+    return *targetMachine;
+  }
+
+  // cross compiling needs every backend, the host only its own
+  if (targetSpec.triple.empty()) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+  } else {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmPrinters();
+    llvm::InitializeAllAsmParsers();
+  }
+
+  auto triple = targetSpec.triple.empty() ? llvm::sys::getDefaultTargetTriple()
+                                          : llvm::Triple::normalize(targetSpec.triple);
+  std::string error;
+  auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+  if (!target) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(), error);
+  }
+
+  // LLVM only warns about unknown CPUs and falls back to the baseline
+  std::unique_ptr<llvm::MCSubtargetInfo> subtarget(
+      target->createMCSubtargetInfo(triple, "", ""));
+  if (targetSpec.cpu != "generic" && subtarget && !subtarget->isCPUStringValid(targetSpec.cpu)) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "unknown CPU `" + targetSpec.cpu + "` for " + triple);
+  }
+
+  targetMachine.reset(target->createTargetMachine(triple, targetSpec.cpu, targetSpec.features,
+                                                  llvm::TargetOptions(), llvm::Reloc::PIC_));
+  if (!targetMachine) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "could not create a target machine for " + triple);
+  }
+  return *targetMachine;
+}
+
 auto Context::recordNote(const std::string &message) -> void {
   errors.back().addNote(message);
 }
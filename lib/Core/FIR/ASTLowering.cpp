@@ -0,0 +1,384 @@
+#include "FIR/ASTLowering.hpp"
+#include <string>
+#include "AST/Nodes.hpp"
+#include "Errors/Context.hpp"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+namespace fern::fir {
+
+namespace {
+
+constexpr ValueId NoValue = ~ValueId(0);
+
+auto elementType(Type base) -> Type {
+  if (base.getReferenceDepth() > 0) {
+    return base.deref();
+  }
+  return Type::Char(); // indexing a `str`
+}
+
+class FunctionLowering {
+  using Scopes = std::vector<std::unordered_map<std::string, ValueId>>;
+
+  Module &module;
+  Function &func;
+  Context &ctx;
+
+  BlockId current = 0;
+  bool terminated = false;
+  Scopes scopes;
+
+public:
+  FunctionLowering(Module &module, Function &func, Context &ctx) :
+      module(module), func(func), ctx(ctx) {}
+
+  auto run(fern::Function &node) -> void {
+    current = func.addBlock();
+    scopes.emplace_back();
+
+    auto args = node.getProto()->getArgs();
+    for (usize i = 0; i < args.size(); ++i) {
+      scopes.back()[args[i]->name] = func.append(current, Opcode::Param, args[i]->type, {}, i);
+    }
+
+    auto value = lower(node.getBody());
+    if (terminated) {
+      return;
+    }
+
+    if (func.returnType == Type::Void()) {
+      func.append(current, Opcode::Ret, Type::Void());
+    } else if (value != NoValue && func.insts[value].type == func.returnType) {
+      func.append(current, Opcode::Ret, Type::Void(), {value});
+    } else {
+      func.append(current, Opcode::Unreachable, Type::Void());
+    }
+  }
+
+private:
+  auto emit(Opcode op, Type type, const std::vector<u32> &ops = {}, i64 imm = 0) -> ValueId {
+    return func.append(current, op, type, ops, imm);
+  }
+
+  auto assign(const std::string &name, ValueId value) -> void {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+      auto found = it->find(name);
+      if (found != it->end()) {
+        found->second = value;
+        return;
+      }
+    }
+    scopes.back()[name] = value;
+  }
+
+  auto lookup(const std::string &name) -> ValueId {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+      auto found = it->find(name);
+      if (found != it->end()) {
+        return found->second;
+      }
+    }
+    return NoValue;
+  }
+
+  // parsed the way CodegenVisitor does, so a literal gets the same bits either way
+  auto lowerNumber(NumberNode &num) -> ValueId {
+    auto literal = num.getValue();
+    llvm::StringRef text = literal;
+
+    if (num.isFloatValue()) {
+      // rounded once to single precision, which a double then holds exactly
+      llvm::APFloat parsed(llvm::APFloat::IEEEsingle());
+      auto status = parsed.convertFromString(text, llvm::APFloat::rmNearestTiesToEven);
+      if (!status) {
+        llvm::consumeError(status.takeError());
+        ctx.recordError("invalid float literal", num.getLocation());
+        return NoValue;
+      }
+
+      auto id = emit(Opcode::ConstFloat, Type::Float());
+      func.insts[id].fimm = parsed.convertToFloat();
+      return id;
+    }
+
+    llvm::APInt parsed;
+    if (text.getAsInteger(10, parsed) || parsed.getActiveBits() > 32) {
+      ctx.recordError("integer literal out of range", num.getLocation());
+      return NoValue;
+    }
+
+    return emit(Opcode::ConstInt, Type::Int(), {}, parsed.zextOrTrunc(32).getSExtValue());
+  }
+
+  auto lower(const std::shared_ptr<AstNode> &node) -> ValueId {
+    if (!node || terminated) {
+      return NoValue;
+    }
+
+    if (auto num = node->as<NumberNode>()) {
+      return lowerNumber(*num);
+    }
+
+    if (auto boolean = node->as<BooleanNode>()) {
+      return emit(Opcode::ConstBool, Type::Bool(), {}, boolean->getValue());
+    }
+
+    if (auto str = node->as<StringNode>()) {
+      return emit(Opcode::ConstStr, Type::Str(), {}, module.internString(str->getValue()));
+    }
+
+    if (auto var = node->as<VariableNode>()) {
+      auto value = lookup(var->getName());
+      if (value == NoValue) {
+        ctx.recordError("variable not found", var->getLocation());
+      }
+      return value;
+    }
+
+    if (auto let = node->as<LetNode>()) {
+      auto value = lower(let->getValue());
+      scopes.back()[let->getName()] = value;
+      return value;
+    }
+
+    if (auto bin = node->as<BinaryNode>()) {
+      return lowerBinary(*bin);
+    }
+
+    if (auto unary = node->as<UnaryNode>()) {
+      auto operand = lower(unary->getOperand());
+      if (operand == NoValue) {
+        return NoValue;
+      }
+
+      auto type = func.insts[operand].type;
+      if (unary->getOp().getKind() == TokenKind::Bang) {
+        return emit(Opcode::Not, type, {operand});
+      }
+      return emit(type == Type::Float() ? Opcode::FNeg : Opcode::Neg, type, {operand});
+    }
+
+    if (auto call = node->as<CallNode>()) {
+      auto callee = module.lookupId(call->getCallee());
+      if (!callee) {
+        ctx.recordError("function not found", call->getLocation());
+        return NoValue;
+      }
+
+      std::vector<u32> args;
+      for (auto &arg: call->getArgs()) {
+        args.push_back(lower(arg));
+        if (args.back() == NoValue) {
+          return NoValue;
+        }
+      }
+
+      return emit(Opcode::Call, module.functions[*callee].returnType, args, *callee);
+    }
+
+    if (auto subscript = node->as<SubscriptNode>()) {
+      auto base = lower(subscript->getOperand());
+      auto index = lower(subscript->getIndex());
+      if (base == NoValue || index == NoValue) {
+        return NoValue;
+      }
+      return emit(Opcode::Index, elementType(func.insts[base].type), {base, index});
+    }
+
+    if (auto block = node->as<BlockNode>()) {
+      scopes.emplace_back();
+      auto value = NoValue;
+      for (auto &stmt: block->getNodes()) {
+        value = lower(stmt);
+      }
+      scopes.pop_back();
+      return value;
+    }
+
+    if (auto ifNode = node->as<IfNode>()) {
+      return lowerIf(*ifNode);
+    }
+
+    if (auto single = node->as<SingleOpNode>()) {
+      if (single->getOp() != TokenKind::Return) {
+        ctx.recordError("invalid single op", single->getLocation());
+        return NoValue;
+      }
+
+      std::vector<u32> ops;
+      if (single->getExpr()) {
+        auto value = lower(single->getExpr());
+        if (value == NoValue) {
+          return NoValue;
+        }
+        ops.push_back(value);
+      }
+
+      emit(Opcode::Ret, Type::Void(), ops);
+      terminated = true;
+      return NoValue;
+    }
+
+    ctx.recordError("cannot lower expression to FIR", node->getLocation());
+    return NoValue;
+  }
+
+  auto lowerBinary(BinaryNode &node) -> ValueId {
+    if (node.getOp() == TokenKind::Equal || node.getOp() == TokenKind::ColonEqual) {
+      auto value = lower(node.getRhs());
+      if (value != NoValue) {
+        assign(node.getLhs()->as<VariableNode>()->getName(), value);
+      }
+      return value;
+    }
+
+    auto lhs = lower(node.getLhs());
+    auto rhs = lower(node.getRhs());
+    if (lhs == NoValue || rhs == NoValue) {
+      return NoValue;
+    }
+
+    auto type = func.insts[lhs].type;
+    bool isFloat = type == Type::Float();
+
+    switch (node.getOp()) {
+    case TokenKind::Plus:
+      return emit(isFloat ? Opcode::FAdd : Opcode::Add, type, {lhs, rhs});
+    case TokenKind::Minus:
+      return emit(isFloat ? Opcode::FSub : Opcode::Sub, type, {lhs, rhs});
+    case TokenKind::Star:
+      return emit(isFloat ? Opcode::FMul : Opcode::Mul, type, {lhs, rhs});
+    case TokenKind::Slash:
+      // sema types every division as float
+      if (!isFloat && node.getType() == Type::Float()) {
+        lhs = emit(Opcode::SIToFP, Type::Float(), {lhs});
+        rhs = emit(Opcode::SIToFP, Type::Float(), {rhs});
+        isFloat = true;
+      }
+      return emit(isFloat ? Opcode::FDiv : Opcode::SDiv, isFloat ? Type::Float() : type,
+                  {lhs, rhs});
+    case TokenKind::EqualEqual:
+      return emit(isFloat ? Opcode::FCmpOEQ : Opcode::ICmpEQ, Type::Bool(), {lhs, rhs});
+    case TokenKind::BangEqual:
+      return emit(isFloat ? Opcode::FCmpUNE : Opcode::ICmpNE, Type::Bool(), {lhs, rhs});
+    case TokenKind::Less:
+      return emit(isFloat ? Opcode::FCmpOLT : Opcode::ICmpSLT, Type::Bool(), {lhs, rhs});
+    case TokenKind::LessEqual:
+      return emit(isFloat ? Opcode::FCmpOLE : Opcode::ICmpSLE, Type::Bool(), {lhs, rhs});
+    case TokenKind::Greater:
+      return emit(isFloat ? Opcode::FCmpOGT : Opcode::ICmpSGT, Type::Bool(), {lhs, rhs});
+    case TokenKind::GreaterEqual:
+      return emit(isFloat ? Opcode::FCmpOGE : Opcode::ICmpSGE, Type::Bool(), {lhs, rhs});
+    default:
+      ctx.recordError("invalid binary op", node.getLocation());
+      return NoValue;
+    }
+  }
+
+  auto lowerIf(IfNode &node) -> ValueId {
+    auto cond = lower(node.getCondition());
+    if (cond == NoValue) {
+      return NoValue;
+    }
+
+    auto condBlock = current;
+    auto thenBlock = func.addBlock();
+    auto elseBlock = node.hasElseBlock() ? func.addBlock() : 0;
+    auto mergeBlock = func.addBlock();
+    auto hint = node.getHint();
+    emit(Opcode::CondBr, Type::Void(),
+         {cond, thenBlock, node.hasElseBlock() ? elseBlock : mergeBlock},
+         hint == BranchHint::Likely ? 1 : hint == BranchHint::Unlikely ? -1 : 0);
+
+    auto before = scopes;
+
+    current = thenBlock;
+    auto thenValue = lower(node.getThenBlock());
+    auto thenEnd = current;
+    auto thenTerminated = terminated;
+    auto thenScopes = scopes;
+
+    scopes = before;
+    terminated = false;
+    auto elseValue = NoValue;
+    auto elseEnd = condBlock;
+    if (node.hasElseBlock()) {
+      current = elseBlock;
+      elseValue = lower(node.getElseBlock());
+      elseEnd = current;
+    }
+    auto elseTerminated = terminated;
+    auto elseScopes = scopes;
+
+    current = mergeBlock;
+    if (thenTerminated && elseTerminated) {
+      return NoValue; // the merge block stays unreachable
+    }
+    terminated = false;
+
+    if (!thenTerminated) {
+      func.append(thenEnd, Opcode::Br, Type::Void(), {mergeBlock});
+    }
+    if (node.hasElseBlock() && !elseTerminated) {
+      func.append(elseEnd, Opcode::Br, Type::Void(), {mergeBlock});
+    }
+
+    // variables reassigned on either side meet in a phi
+    auto join = [&](ValueId thenVal, ValueId elseVal) -> ValueId {
+      if (thenTerminated || thenVal == NoValue) {
+        return elseTerminated ? NoValue : elseVal;
+      }
+      if (elseTerminated || elseVal == NoValue || thenVal == elseVal) {
+        return thenVal;
+      }
+      return emit(Opcode::Phi, func.insts[thenVal].type, {thenVal, thenEnd, elseVal, elseEnd});
+    };
+
+    scopes = before;
+    for (usize level = 0; level < scopes.size(); ++level) {
+      for (auto &[name, value]: scopes[level]) {
+        value = join(thenScopes[level][name], elseScopes[level][name]);
+      }
+    }
+
+    if (node.getType() == Type::Void() || !node.hasElseBlock()) {
+      return NoValue;
+    }
+    return join(thenValue, elseValue);
+  }
+};
+
+} // namespace
+
+auto lowerProgram(ProgramNode &program, Context &ctx) -> Module {
+  Module module;
+
+  auto declare = [&](const std::shared_ptr<Prototype> &proto, bool isExtern) {
+    Function func;
+    func.name = proto->getName();
+    func.paramTypes = proto->getArgTypes();
+    func.returnType = proto->getReturnType();
+    func.proto = proto;
+    func.isExtern = isExtern;
+    module.addFunction(std::move(func));
+  };
+
+  for (auto &ext: program.getExterns()) {
+    declare(ext->getProto(), true);
+  }
+  for (auto &func: program.getFunctions()) {
+    declare(func->getProto(), false);
+  }
+
+  for (auto &node: program.getFunctions()) {
+    auto &func = module.functions[*module.lookupId(node->getName())];
+    FunctionLowering(module, func, ctx).run(*node);
+  }
+
+  return module;
+}
+
+} // namespace fern::fir
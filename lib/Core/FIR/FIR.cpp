@@ -0,0 +1,407 @@
+#include "FIR/FIR.hpp"
+#include <algorithm>
+#include "llvm/Support/Format.h"
+
+namespace fern::fir {
+
+auto opcodeName(Opcode op) -> const char * {
+  switch (op) {
+  case Opcode::Nop:
+    return "nop";
+  case Opcode::ConstInt:
+    return "const.int";
+  case Opcode::ConstFloat:
+    return "const.float";
+  case Opcode::ConstBool:
+    return "const.bool";
+  case Opcode::ConstStr:
+    return "const.str";
+  case Opcode::Param:
+    return "param";
+  case Opcode::Add:
+    return "add";
+  case Opcode::Sub:
+    return "sub";
+  case Opcode::Mul:
+    return "mul";
+  case Opcode::SDiv:
+    return "sdiv";
+  case Opcode::FAdd:
+    return "fadd";
+  case Opcode::FSub:
+    return "fsub";
+  case Opcode::FMul:
+    return "fmul";
+  case Opcode::FDiv:
+    return "fdiv";
+  case Opcode::Neg:
+    return "neg";
+  case Opcode::FNeg:
+    return "fneg";
+  case Opcode::Not:
+    return "not";
+  case Opcode::SIToFP:
+    return "sitofp";
+  case Opcode::ICmpEQ:
+    return "icmp.eq";
+  case Opcode::ICmpNE:
+    return "icmp.ne";
+  case Opcode::ICmpSLT:
+    return "icmp.slt";
+  case Opcode::ICmpSLE:
+    return "icmp.sle";
+  case Opcode::ICmpSGT:
+    return "icmp.sgt";
+  case Opcode::ICmpSGE:
+    return "icmp.sge";
+  case Opcode::FCmpOEQ:
+    return "fcmp.oeq";
+  case Opcode::FCmpUNE:
+    return "fcmp.une";
+  case Opcode::FCmpOLT:
+    return "fcmp.olt";
+  case Opcode::FCmpOLE:
+    return "fcmp.ole";
+  case Opcode::FCmpOGT:
+    return "fcmp.ogt";
+  case Opcode::FCmpOGE:
+    return "fcmp.oge";
+  case Opcode::Index:
+    return "index";
+  case Opcode::Call:
+    return "call";
+  case Opcode::Phi:
+    return "phi";
+  case Opcode::Copy:
+    return "copy";
+  case Opcode::Br:
+    return "br";
+  case Opcode::CondBr:
+    return "condbr";
+  case Opcode::Ret:
+    return "ret";
+  case Opcode::Unreachable:
+    return "unreachable";
+  }
+  return "unknown";
+}
+
+auto isTerminator(Opcode op) -> bool {
+  return op == Opcode::Br || op == Opcode::CondBr || op == Opcode::Ret ||
+         op == Opcode::Unreachable;
+}
+
+auto hasSideEffects(Opcode op) -> bool {
+  // index reads memory that an earlier call may have written, so it is never
+  // moved or merged, but it can be dropped when unused
+  return op == Opcode::Call || isTerminator(op);
+}
+
+auto Function::addBlock() -> BlockId {
+  blocks.emplace_back();
+  return blocks.size() - 1;
+}
+
+auto Function::create(Opcode op, Type type, const std::vector<u32> &ops, i64 imm) -> ValueId {
+  Inst inst;
+  inst.op = op;
+  inst.type = type;
+  inst.firstOperand = operands.size();
+  inst.numOperands = ops.size();
+  inst.imm = imm;
+  operands.insert(operands.end(), ops.begin(), ops.end());
+  insts.push_back(inst);
+  return insts.size() - 1;
+}
+
+auto Function::append(BlockId block, Opcode op, Type type, const std::vector<u32> &ops,
+                      i64 imm) -> ValueId {
+  auto id = create(op, type, ops, imm);
+  insts[id].block = block;
+  blocks[block].insts.push_back(id);
+  return id;
+}
+
+auto Function::isValueOperand(ValueId id, u32 index) const -> bool {
+  switch (insts[id].op) {
+  case Opcode::Br:
+    return false;
+  case Opcode::CondBr:
+    return index == 0;
+  case Opcode::Phi:
+    return index % 2 == 0;
+  default:
+    return true;
+  }
+}
+
+auto Function::erase(ValueId id) -> void {
+  auto &list = blocks[insts[id].block].insts;
+  list.erase(std::remove(list.begin(), list.end(), id), list.end());
+  insts[id].op = Opcode::Nop;
+  insts[id].numOperands = 0;
+}
+
+auto Function::replaceAllUses(ValueId from, ValueId to) -> void {
+  for (ValueId id = 0; id < insts.size(); ++id) {
+    auto ops = getOperands(id);
+    for (u32 i = 0; i < ops.size(); ++i) {
+      if (ops[i] == from && isValueOperand(id, i)) {
+        ops[i] = to;
+      }
+    }
+  }
+}
+
+auto Function::replaceUses(const std::vector<ValueId> &replacement) -> void {
+  auto resolve = [&](ValueId value) {
+    while (value < replacement.size() && replacement[value] != value) {
+      value = replacement[value];
+    }
+    return value;
+  };
+
+  for (ValueId id = 0; id < insts.size(); ++id) {
+    auto ops = getOperands(id);
+    for (u32 i = 0; i < ops.size(); ++i) {
+      if (isValueOperand(id, i)) {
+        ops[i] = resolve(ops[i]);
+      }
+    }
+  }
+}
+
+auto Function::countUses() const -> std::vector<u32> {
+  std::vector<u32> uses(insts.size(), 0);
+  for (ValueId id = 0; id < insts.size(); ++id) {
+    auto &inst = insts[id];
+    for (u32 i = 0; i < inst.numOperands; ++i) {
+      if (isValueOperand(id, i)) {
+        uses[operands[inst.firstOperand + i]]++;
+      }
+    }
+  }
+  return uses;
+}
+
+auto Function::getTerminator(BlockId block) const -> const Inst * {
+  auto &list = blocks[block].insts;
+  if (list.empty() || !isTerminator(insts[list.back()].op)) {
+    return nullptr;
+  }
+  return &insts[list.back()];
+}
+
+auto Function::successors(BlockId block) -> std::vector<BlockId> {
+  auto term = getTerminator(block);
+  if (!term) {
+    return {};
+  }
+
+  auto first = operands.begin() + term->firstOperand;
+  if (term->op == Opcode::Br) {
+    return {first[0]};
+  } else if (term->op == Opcode::CondBr) {
+    return {first[1], first[2]};
+  }
+  return {};
+}
+
+auto Function::predecessors() -> std::vector<std::vector<BlockId>> {
+  std::vector<std::vector<BlockId>> preds(blocks.size());
+  for (auto block: reversePostOrder()) {
+    for (auto succ: successors(block)) {
+      preds[succ].push_back(block);
+    }
+  }
+  return preds;
+}
+
+auto Function::reversePostOrder() -> std::vector<BlockId> {
+  std::vector<BlockId> order;
+  if (blocks.empty()) {
+    return order;
+  }
+
+  std::vector<bool> visited(blocks.size(), false);
+  std::vector<std::pair<BlockId, usize>> stack{{0, 0}};
+  visited[0] = true;
+
+  while (!stack.empty()) {
+    auto &[block, next] = stack.back();
+    auto succs = successors(block);
+    if (next < succs.size()) {
+      auto succ = succs[next++];
+      if (!visited[succ]) {
+        visited[succ] = true;
+        stack.emplace_back(succ, 0);
+      }
+      continue;
+    }
+
+    order.push_back(block);
+    stack.pop_back();
+  }
+
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+auto Function::dominators() -> std::vector<BlockId> {
+  // cooper, harvey & kennedy's iterative algorithm
+  constexpr BlockId undefined = ~BlockId(0);
+  auto rpo = reversePostOrder();
+  auto preds = predecessors();
+
+  std::vector<u32> rpoIndex(blocks.size(), undefined);
+  for (u32 i = 0; i < rpo.size(); ++i) {
+    rpoIndex[rpo[i]] = i;
+  }
+
+  std::vector<BlockId> idom(blocks.size(), undefined);
+  if (rpo.empty()) {
+    return idom;
+  }
+  idom[rpo[0]] = rpo[0];
+
+  auto intersect = [&](BlockId a, BlockId b) {
+    while (a != b) {
+      while (rpoIndex[a] > rpoIndex[b]) {
+        a = idom[a];
+      }
+      while (rpoIndex[b] > rpoIndex[a]) {
+        b = idom[b];
+      }
+    }
+    return a;
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (usize i = 1; i < rpo.size(); ++i) {
+      auto block = rpo[i];
+      auto newIdom = undefined;
+      for (auto pred: preds[block]) {
+        if (idom[pred] == undefined) {
+          continue;
+        }
+        newIdom = newIdom == undefined ? pred : intersect(pred, newIdom);
+      }
+
+      if (idom[block] != newIdom) {
+        idom[block] = newIdom;
+        changed = true;
+      }
+    }
+  }
+
+  return idom;
+}
+
+auto Function::liveInstCount() const -> usize {
+  usize count = 0;
+  for (auto &block: blocks) {
+    count += block.insts.size();
+  }
+  return count;
+}
+
+auto Module::addFunction(Function func) -> FuncId {
+  functionIds.emplace(func.name, functions.size());
+  functions.push_back(std::move(func));
+  return functions.size() - 1;
+}
+
+auto Module::lookup(const std::string &name) const -> const Function * {
+  auto id = lookupId(name);
+  return id ? &functions[*id] : nullptr;
+}
+
+auto Module::lookupId(const std::string &name) const -> std::optional<FuncId> {
+  auto found = functionIds.find(name);
+  if (found == functionIds.end()) {
+    return std::nullopt;
+  }
+  return found->second;
+}
+
+auto Module::internString(const std::string &value) -> u32 {
+  auto [it, inserted] = stringIds.emplace(value, strings.size());
+  if (inserted) {
+    strings.push_back(value);
+  }
+  return it->second;
+}
+
+auto Module::print(llvm::raw_ostream &out) -> void {
+  for (auto &func: functions) {
+    out << (func.isExtern ? "extern func @" : "func @") << func.name << "(";
+    for (usize i = 0; i < func.paramTypes.size(); ++i) {
+      out << (i ? ", " : "") << func.paramTypes[i].getTypeName();
+      if (i < func.noCaptureParams.size() && func.noCaptureParams[i]) {
+        out << " nocapture";
+      }
+    }
+    out << ") -> " << func.returnType.getTypeName();
+
+    if (func.isExtern) {
+      out << "\n";
+      continue;
+    }
+    out << " {\n";
+
+    for (auto block: func.reversePostOrder()) {
+      out << "bb" << block << ":\n";
+      for (auto id: func.blocks[block].insts) {
+        auto &inst = func.insts[id];
+        out << "  ";
+        if (inst.type.getKind() != TypeKind::Void && !isTerminator(inst.op)) {
+          out << "%" << id << " = ";
+        }
+        out << opcodeName(inst.op);
+
+        switch (inst.op) {
+        case Opcode::ConstInt:
+        case Opcode::ConstBool:
+        case Opcode::Param:
+          out << " " << inst.imm;
+          break;
+        case Opcode::ConstFloat:
+          out << " " << llvm::format("%g", inst.fimm);
+          break;
+        case Opcode::ConstStr:
+          out << " \"";
+          out.write_escaped(strings[inst.imm]);
+          out << "\"";
+          break;
+        case Opcode::Call:
+          out << " @" << functions[inst.imm].name;
+          break;
+        default:
+          break;
+        }
+
+        auto ops = func.getOperands(id);
+        for (u32 i = 0; i < ops.size(); ++i) {
+          out << (i ? ", " : " ") << (func.isValueOperand(id, i) ? "%" : "bb") << ops[i];
+        }
+
+        if (inst.op == Opcode::Index && inst.imm) {
+          out << " inbounds";
+        }
+        if (inst.op == Opcode::CondBr && inst.imm) {
+          out << (inst.imm > 0 ? " likely" : " unlikely");
+        }
+        if (inst.type.getKind() != TypeKind::Void && !isTerminator(inst.op)) {
+          out << " : " << inst.type.getTypeName();
+        }
+        out << "\n";
+      }
+    }
+
+    out << "}\n";
+  }
+}
+
+} // namespace fern::fir
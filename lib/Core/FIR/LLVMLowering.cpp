@@ -0,0 +1,211 @@
+#include "FIR/LLVMLowering.hpp"
+#include "AST/Nodes.hpp"
+#include "Analysis/AttributeInference.hpp"
+#include "Codegen/CodegenVisitor.hpp"
+#include "Errors/Context.hpp"
+#include "llvm/IR/Verifier.h"
+
+namespace fern::fir {
+
+namespace {
+
+class FunctionEmitter {
+  Module &module;
+  Function &func;
+  Context &ctx;
+  CodegenVisitor &codegen;
+  const AttributeInference *attrs;
+
+  llvm::IRBuilder<> &builder;
+  std::vector<llvm::BasicBlock *> blocks;
+  std::vector<llvm::Value *> values;
+
+public:
+  FunctionEmitter(Module &module, Function &func, Context &ctx, CodegenVisitor &codegen,
+                  const AttributeInference *attrs) :
+      module(module), func(func), ctx(ctx), codegen(codegen), attrs(attrs),
+      builder(ctx.getBuilder()) {}
+
+  auto run(llvm::Function *llvmFunc) -> void {
+    for (usize i = 0; i < func.noCaptureParams.size(); ++i) {
+      if (func.noCaptureParams[i]) {
+        llvmFunc->addParamAttr(i, llvm::Attribute::NoCapture);
+      }
+    }
+    // FIR keeps no source locations, so debug info attributes the whole body to the
+    // prototype's line
+    codegen.beginFunctionBody(*llvmFunc, *func.proto);
+
+    auto rpo = func.reversePostOrder();
+    blocks.assign(func.blocks.size(), nullptr);
+    for (auto block: rpo) {
+      blocks[block] = llvm::BasicBlock::Create(ctx.getLLVMContext(), "bb", llvmFunc);
+    }
+    values.assign(func.insts.size(), nullptr);
+
+    // phis are created with their block and filled in once every value exists
+    std::vector<ValueId> phis;
+    for (auto block: rpo) {
+      builder.SetInsertPoint(blocks[block]);
+      for (auto id: func.blocks[block].insts) {
+        if (func.insts[id].op == Opcode::Phi) {
+          phis.push_back(id);
+        }
+        values[id] = emit(id, llvmFunc);
+      }
+    }
+
+    for (auto id: phis) {
+      auto phi = llvm::cast<llvm::PHINode>(values[id]);
+      auto ops = func.getOperands(id);
+      for (u32 i = 0; i < ops.size(); i += 2) {
+        if (blocks[ops[i + 1]]) {
+          phi->addIncoming(values[ops[i]], blocks[ops[i + 1]]);
+        }
+      }
+    }
+
+    codegen.endFunctionBody();
+
+    if (codegen.shouldVerifyFunctions() && llvm::verifyFunction(*llvmFunc, &llvm::errs())) {
+      ctx.recordError("llvm function verification failed", func.proto->getLocation());
+      llvmFunc->print(llvm::errs());
+      llvmFunc->eraseFromParent();
+    }
+  }
+
+private:
+  auto type(Type type) -> llvm::Type * { return type.codegen(codegen); }
+
+  auto emit(ValueId id, llvm::Function *llvmFunc) -> llvm::Value * {
+    auto &inst = func.insts[id];
+    auto ops = func.getOperands(id);
+    auto op = [&](u32 i) { return values[ops[i]]; };
+
+    switch (inst.op) {
+    case Opcode::Nop:
+      return nullptr;
+    case Opcode::ConstInt:
+    case Opcode::ConstBool:
+      return llvm::ConstantInt::get(type(inst.type), inst.imm, true);
+    case Opcode::ConstFloat:
+      return llvm::ConstantFP::get(type(inst.type), inst.fimm);
+    case Opcode::ConstStr:
+      return codegen.getStringLiteral(module.strings[inst.imm]);
+    case Opcode::Param:
+      return llvmFunc->getArg(inst.imm);
+
+    case Opcode::Add:
+      return builder.CreateAdd(op(0), op(1));
+    case Opcode::Sub:
+      return builder.CreateSub(op(0), op(1));
+    case Opcode::Mul:
+      return builder.CreateMul(op(0), op(1));
+    case Opcode::SDiv:
+      return builder.CreateSDiv(op(0), op(1));
+    case Opcode::FAdd:
+      return builder.CreateFAdd(op(0), op(1));
+    case Opcode::FSub:
+      return builder.CreateFSub(op(0), op(1));
+    case Opcode::FMul:
+      return builder.CreateFMul(op(0), op(1));
+    case Opcode::FDiv:
+      return builder.CreateFDiv(op(0), op(1));
+    case Opcode::Neg:
+      return builder.CreateNeg(op(0));
+    case Opcode::FNeg:
+      return builder.CreateFNeg(op(0));
+    case Opcode::Not:
+      return builder.CreateNot(op(0));
+    case Opcode::SIToFP:
+      return builder.CreateSIToFP(op(0), type(inst.type));
+
+    case Opcode::ICmpEQ:
+      return builder.CreateICmpEQ(op(0), op(1));
+    case Opcode::ICmpNE:
+      return builder.CreateICmpNE(op(0), op(1));
+    case Opcode::ICmpSLT:
+      return builder.CreateICmpSLT(op(0), op(1));
+    case Opcode::ICmpSLE:
+      return builder.CreateICmpSLE(op(0), op(1));
+    case Opcode::ICmpSGT:
+      return builder.CreateICmpSGT(op(0), op(1));
+    case Opcode::ICmpSGE:
+      return builder.CreateICmpSGE(op(0), op(1));
+    case Opcode::FCmpOEQ:
+      return builder.CreateFCmpOEQ(op(0), op(1));
+    case Opcode::FCmpUNE:
+      return builder.CreateFCmpUNE(op(0), op(1));
+    case Opcode::FCmpOLT:
+      return builder.CreateFCmpOLT(op(0), op(1));
+    case Opcode::FCmpOLE:
+      return builder.CreateFCmpOLE(op(0), op(1));
+    case Opcode::FCmpOGT:
+      return builder.CreateFCmpOGT(op(0), op(1));
+    case Opcode::FCmpOGE:
+      return builder.CreateFCmpOGE(op(0), op(1));
+
+    case Opcode::Index: {
+      auto elemType = type(inst.type);
+      auto ptr = inst.imm ? builder.CreateInBoundsGEP(elemType, op(0), op(1))
+                          : builder.CreateGEP(elemType, op(0), op(1));
+      return builder.CreateLoad(elemType, ptr);
+    }
+
+    case Opcode::Call: {
+      auto &callee = module.functions[inst.imm];
+      std::vector<llvm::Value *> args;
+      for (u32 i = 0; i < ops.size(); ++i) {
+        args.push_back(op(i));
+      }
+
+      auto llvmCallee = ctx.getModule().getFunction(callee.name);
+      auto call = builder.CreateCall(llvmCallee, args);
+      call->setCallingConv(llvmCallee->getCallingConv());
+      if (attrs) {
+        attrs->apply(*call, callee.name);
+      }
+      return call;
+    }
+    case Opcode::Phi:
+      return builder.CreatePHI(type(inst.type), ops.size() / 2);
+    case Opcode::Copy:
+      return op(0);
+
+    case Opcode::Br:
+      return builder.CreateBr(blocks[ops[0]]);
+    case Opcode::CondBr:
+      return codegen.createCondBr(op(0), blocks[ops[1]], blocks[ops[2]],
+                                  inst.imm > 0   ? BranchHint::Likely
+                                  : inst.imm < 0 ? BranchHint::Unlikely
+                                                 : BranchHint::None);
+    case Opcode::Ret:
+      return ops.empty() ? builder.CreateRetVoid() : builder.CreateRet(op(0));
+    case Opcode::Unreachable:
+      return builder.CreateUnreachable();
+    }
+
+    return nullptr;
+  }
+};
+
+} // namespace
+
+auto lowerToLLVM(Module &module, Context &ctx, CodegenVisitor &codegen,
+                 const AttributeInference *attrs) -> void {
+  std::vector<llvm::Function *> llvmFuncs;
+  for (auto &func: module.functions) {
+    llvmFuncs.push_back(func.proto->codegen(codegen));
+  }
+
+  for (usize i = 0; i < module.functions.size(); ++i) {
+    auto &func = module.functions[i];
+    if (func.isExtern || !llvmFuncs[i]) {
+      continue;
+    }
+
+    FunctionEmitter(module, func, ctx, codegen, attrs).run(llvmFuncs[i]);
+  }
+}
+
+} // namespace fern::fir
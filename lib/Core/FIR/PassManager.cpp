@@ -0,0 +1,32 @@
+#include "FIR/Passes.hpp"
+#include "Support/Statistics.hpp"
+
+namespace fern::fir {
+
+auto PassManager::run(Module &module) -> void {
+  for (auto &pass: passes) {
+    if (!stats) {
+      pass->run(module);
+      continue;
+    }
+
+    auto timer = stats->time(std::string("fir: ") + pass->getName());
+    pass->run(module);
+  }
+}
+
+auto PassManager::buildDefaultPipeline(const AttributeInference *attrs, Statistics *stats)
+    -> PassManager {
+  PassManager pm(stats);
+  pm.add(createCopyPropagationPass());
+  pm.add(createInlinerPass(32));
+  pm.add(createMergeBlocksPass());
+  pm.add(createCopyPropagationPass());
+  pm.add(createGVNPass(attrs));
+  pm.add(createBoundsPass());
+  pm.add(createDeadCodeEliminationPass(attrs));
+  pm.add(createEscapeAnalysisPass());
+  return pm;
+}
+
+} // namespace fern::fir
@@ -0,0 +1,659 @@
+#include "FIR/Passes.hpp"
+#include <algorithm>
+#include <bit>
+#include <map>
+#include "AST/Prototype.hpp"
+#include "Analysis/AttributeInference.hpp"
+#include "Support/OptLevel.hpp"
+
+namespace fern::fir {
+
+namespace {
+
+auto isPointer(const Type &type) -> bool {
+  return type.getReferenceDepth() > 0 || type.getKind() == TypeKind::Str;
+}
+
+auto identity(const Function &func) -> std::vector<ValueId> {
+  std::vector<ValueId> replacement(func.insts.size());
+  for (ValueId id = 0; id < replacement.size(); ++id) {
+    replacement[id] = id;
+  }
+  return replacement;
+}
+
+auto isPure(const Module &module, const Inst &inst, const AttributeInference *attrs) -> bool {
+  if (inst.op != Opcode::Call) {
+    return !hasSideEffects(inst.op) && inst.op != Opcode::Index;
+  }
+  if (!attrs) {
+    return false;
+  }
+
+  auto &callee = module.functions[inst.imm];
+  auto fx = callee.isExtern ? nullptr : attrs->lookup(callee.name);
+  return fx && fx->memory == MemoryEffect::None && fx->willReturn && fx->noUnwind;
+}
+
+class CopyPropagation : public Pass {
+public:
+  auto getName() const -> const char * override { return "copy-propagation"; }
+
+  auto run(Module &module) -> bool override {
+    bool changed = false;
+    for (auto &func: module.functions) {
+      if (!func.isExtern) {
+        changed |= runOnFunction(func);
+      }
+    }
+    return changed;
+  }
+
+private:
+  auto runOnFunction(Function &func) -> bool {
+    auto replacement = identity(func);
+    auto resolve = [&](ValueId value) {
+      while (replacement[value] != value) {
+        value = replacement[value];
+      }
+      return value;
+    };
+
+    bool changed = false;
+    bool progress = true;
+    while (progress) {
+      progress = false;
+      for (ValueId id = 0; id < func.insts.size(); ++id) {
+        auto &inst = func.insts[id];
+        if (replacement[id] != id) {
+          continue;
+        }
+
+        if (inst.op == Opcode::Copy) {
+          replacement[id] = resolve(func.getOperands(id)[0]);
+          progress = true;
+          continue;
+        }
+        if (inst.op != Opcode::Phi) {
+          continue;
+        }
+
+        // a phi whose incoming values are all the same value (or itself) is trivial
+        auto ops = func.getOperands(id);
+        auto unique = ~ValueId(0);
+        bool trivial = true;
+        for (u32 i = 0; i < ops.size(); i += 2) {
+          auto value = resolve(ops[i]);
+          if (value == id || value == unique) {
+            continue;
+          }
+          if (unique != ~ValueId(0)) {
+            trivial = false;
+            break;
+          }
+          unique = value;
+        }
+
+        if (trivial && unique != ~ValueId(0)) {
+          replacement[id] = unique;
+          progress = true;
+        }
+      }
+      changed |= progress;
+    }
+
+    if (!changed) {
+      return false;
+    }
+
+    func.replaceUses(replacement);
+    for (ValueId id = 0; id < replacement.size(); ++id) {
+      if (replacement[id] != id) {
+        func.erase(id);
+      }
+    }
+    return true;
+  }
+};
+
+class GVN : public Pass {
+  const AttributeInference *attrs;
+
+public:
+  GVN(const AttributeInference *attrs) : attrs(attrs) {}
+
+  auto getName() const -> const char * override { return "gvn"; }
+
+  auto run(Module &module) -> bool override {
+    bool changed = false;
+    for (auto &func: module.functions) {
+      if (!func.isExtern) {
+        changed |= runOnFunction(module, func);
+      }
+    }
+    return changed;
+  }
+
+private:
+  using Key = std::vector<i64>;
+
+  static auto isCommutative(Opcode op) -> bool {
+    switch (op) {
+    case Opcode::Add:
+    case Opcode::Mul:
+    case Opcode::FAdd:
+    case Opcode::FMul:
+    case Opcode::ICmpEQ:
+    case Opcode::ICmpNE:
+    case Opcode::FCmpOEQ:
+    case Opcode::FCmpUNE:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  auto runOnFunction(Module &module, Function &func) -> bool {
+    auto idom = func.dominators();
+    std::vector<std::vector<BlockId>> children(func.blocks.size());
+    for (auto block: func.reversePostOrder()) {
+      if (block != 0) {
+        children[idom[block]].push_back(block);
+      }
+    }
+
+    auto replacement = identity(func);
+    std::map<Key, ValueId> table;
+    std::vector<Key> added;
+    bool changed = false;
+
+    // walk the dominator tree, values are only visible in the blocks they dominate
+    std::vector<std::pair<BlockId, usize>> stack{{0, 0}};
+    std::vector<usize> marks;
+    while (!stack.empty()) {
+      auto &[block, next] = stack.back();
+      if (next == 0) {
+        marks.push_back(added.size());
+        auto list = func.blocks[block].insts;
+        for (auto id: list) {
+          auto &inst = func.insts[id];
+          if (inst.op == Opcode::Phi || !isPure(module, inst, attrs)) {
+            continue;
+          }
+
+          Key key{i64(inst.op), i64(inst.type.getKind()), i64(inst.type.getReferenceDepth()),
+                  inst.imm, std::bit_cast<i64>(inst.fimm)};
+          auto ops = func.getOperands(id);
+          std::vector<i64> values;
+          for (auto op: ops) {
+            values.push_back(replacement[op]);
+          }
+          if (isCommutative(inst.op)) {
+            std::sort(values.begin(), values.end());
+          }
+          key.insert(key.end(), values.begin(), values.end());
+
+          auto [it, inserted] = table.emplace(key, id);
+          if (inserted) {
+            added.push_back(key);
+          } else {
+            replacement[id] = it->second;
+            func.erase(id);
+            changed = true;
+          }
+        }
+      }
+
+      if (next < children[block].size()) {
+        auto child = children[block][next++];
+        stack.emplace_back(child, 0);
+        continue;
+      }
+
+      for (auto count = marks.back(); added.size() > count; added.pop_back()) {
+        table.erase(added.back());
+      }
+      marks.pop_back();
+      stack.pop_back();
+    }
+
+    if (changed) {
+      func.replaceUses(replacement);
+    }
+    return changed;
+  }
+};
+
+class Inliner : public Pass {
+  usize threshold;
+
+public:
+  Inliner(usize threshold) : threshold(threshold) {}
+
+  auto getName() const -> const char * override { return "inline"; }
+
+  auto run(Module &module) -> bool override {
+    bool changed = false;
+    for (FuncId callerId = 0; callerId < module.functions.size(); ++callerId) {
+      auto &caller = module.functions[callerId];
+      if (caller.isExtern || isOptNone(caller)) {
+        continue;
+      }
+
+      // only the call sites present before inlining, so inlined bodies aren't revisited
+      auto count = caller.insts.size();
+      for (ValueId id = 0; id < count; ++id) {
+        auto &inst = caller.insts[id];
+        if (inst.op != Opcode::Call || inst.imm == callerId) {
+          continue;
+        }
+
+        auto &callee = module.functions[inst.imm];
+        if (shouldInline(FuncId(inst.imm), callee)) {
+          inlineCall(caller, id, callee);
+          changed = true;
+        }
+      }
+    }
+    return changed;
+  }
+
+private:
+  static auto isOptNone(const Function &func) -> bool {
+    auto opt = func.proto->getAnnotation("optimize");
+    return opt && parseOptLevel(opt->args[0]) == OptLevel::O0;
+  }
+
+  auto shouldInline(FuncId calleeId, const Function &callee) const -> bool {
+    // `@optimize(O0)` functions are noinline on the LLVM path too
+    if (callee.isExtern || callee.blocks.empty() || isOptNone(callee) ||
+        callee.liveInstCount() > threshold) {
+      return false;
+    }
+
+    bool returns = false;
+    for (auto &block: callee.blocks) {
+      for (auto id: block.insts) {
+        auto &inst = callee.insts[id];
+        if (inst.op == Opcode::Call && inst.imm == calleeId) {
+          return false;
+        }
+        returns |= inst.op == Opcode::Ret;
+      }
+    }
+    return returns;
+  }
+
+  auto inlineCall(Function &caller, ValueId call, const Function &callee) -> void {
+    auto block = caller.insts[call].block;
+    auto args = std::vector<u32>(caller.getOperands(call).begin(),
+                                 caller.getOperands(call).end());
+
+    // split the block after the call, the tail becomes the continuation
+    auto cont = caller.addBlock();
+    {
+      auto &list = caller.blocks[block].insts;
+      auto pos = std::find(list.begin(), list.end(), call);
+      caller.blocks[cont].insts.assign(pos + 1, list.end());
+      list.erase(pos + 1, list.end());
+    }
+    for (auto id: caller.blocks[cont].insts) {
+      caller.insts[id].block = cont;
+    }
+    for (auto succ: caller.successors(cont)) {
+      for (auto id: caller.blocks[succ].insts) {
+        if (caller.insts[id].op != Opcode::Phi) {
+          continue;
+        }
+        auto ops = caller.getOperands(id);
+        for (u32 i = 1; i < ops.size(); i += 2) {
+          if (ops[i] == block) {
+            ops[i] = cont;
+          }
+        }
+      }
+    }
+
+    std::vector<BlockId> blockMap(callee.blocks.size());
+    for (auto &id: blockMap) {
+      id = caller.addBlock();
+    }
+
+    std::vector<ValueId> valueMap(callee.insts.size(), ~ValueId(0));
+    std::vector<ValueId> cloned;
+    std::vector<std::pair<ValueId, BlockId>> returns;
+    for (BlockId b = 0; b < callee.blocks.size(); ++b) {
+      for (auto id: callee.blocks[b].insts) {
+        auto &inst = callee.insts[id];
+        auto first = callee.operands.begin() + inst.firstOperand;
+        std::vector<u32> ops(first, first + inst.numOperands);
+
+        if (inst.op == Opcode::Param) {
+          valueMap[id] = args[inst.imm];
+          continue;
+        }
+        if (inst.op == Opcode::Ret) {
+          if (!ops.empty()) {
+            returns.emplace_back(ops[0], blockMap[b]);
+          }
+          caller.append(blockMap[b], Opcode::Br, Type::Void(), {cont});
+          continue;
+        }
+
+        auto newId = caller.append(blockMap[b], inst.op, inst.type, ops, inst.imm);
+        caller.insts[newId].fimm = inst.fimm;
+        valueMap[id] = newId;
+        cloned.push_back(newId);
+      }
+    }
+
+    for (auto id: cloned) {
+      auto ops = caller.getOperands(id);
+      for (u32 i = 0; i < ops.size(); ++i) {
+        ops[i] = caller.isValueOperand(id, i) ? valueMap[ops[i]] : blockMap[ops[i]];
+      }
+    }
+
+    auto type = caller.insts[call].type;
+    caller.erase(call);
+    caller.append(block, Opcode::Br, Type::Void(), {blockMap[0]});
+
+    if (type == Type::Void() || returns.empty()) {
+      return;
+    }
+
+    ValueId result;
+    if (returns.size() == 1) {
+      result = valueMap[returns[0].first];
+    } else {
+      std::vector<u32> incoming;
+      for (auto [value, from]: returns) {
+        incoming.push_back(valueMap[value]);
+        incoming.push_back(from);
+      }
+      result = caller.create(Opcode::Phi, type, incoming);
+      caller.insts[result].block = cont;
+      auto &list = caller.blocks[cont].insts;
+      list.insert(list.begin(), result);
+    }
+    caller.replaceAllUses(call, result);
+  }
+};
+
+class Bounds : public Pass {
+public:
+  auto getName() const -> const char * override { return "bounds"; }
+
+  auto run(Module &module) -> bool override {
+    bool changed = false;
+    for (auto &func: module.functions) {
+      for (ValueId id = 0; id < func.insts.size(); ++id) {
+        if (func.insts[id].op != Opcode::Index || func.insts[id].imm) {
+          continue;
+        }
+
+        auto ops = func.getOperands(id);
+        auto &base = func.insts[ops[0]];
+        auto &index = func.insts[ops[1]];
+        if (index.op != Opcode::ConstInt) {
+          continue;
+        }
+
+        if (base.op == Opcode::ConstStr) {
+          // reading a literal at a constant index, including its terminator
+          auto &str = module.strings[base.imm];
+          if (index.imm < 0 || usize(index.imm) > str.size()) {
+            continue;
+          }
+
+          auto &inst = func.insts[id];
+          inst.op = Opcode::ConstInt;
+          inst.imm = usize(index.imm) < str.size() ? u8(str[index.imm]) : 0;
+          inst.numOperands = 0;
+          changed = true;
+        } else if (base.type.getKind() == TypeKind::Str && index.imm == 0) {
+          // every `str` holds at least its terminator
+          func.insts[id].imm = 1;
+          changed = true;
+        }
+      }
+    }
+    return changed;
+  }
+};
+
+class EscapeAnalysis : public Pass {
+public:
+  auto getName() const -> const char * override { return "escape-analysis"; }
+
+  auto run(Module &module) -> bool override {
+    // optimistically assume no pointer parameter of a Fern function escapes, then
+    // drop the assumption for every parameter that flows somewhere it might
+    for (auto &func: module.functions) {
+      func.noCaptureParams.assign(func.paramTypes.size(), false);
+      if (func.isExtern) {
+        continue;
+      }
+      for (usize i = 0; i < func.paramTypes.size(); ++i) {
+        func.noCaptureParams[i] = isPointer(func.paramTypes[i]);
+      }
+    }
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (auto &func: module.functions) {
+        if (func.isExtern) {
+          continue;
+        }
+
+        auto users = buildUsers(func);
+        for (ValueId id = 0; id < func.insts.size(); ++id) {
+          auto &inst = func.insts[id];
+          if (inst.op != Opcode::Param || !func.noCaptureParams[inst.imm]) {
+            continue;
+          }
+          if (escapes(module, func, users, id)) {
+            func.noCaptureParams[inst.imm] = false;
+            changed = true;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+private:
+  using Users = std::vector<std::vector<std::pair<ValueId, u32>>>;
+
+  static auto buildUsers(Function &func) -> Users {
+    Users users(func.insts.size());
+    for (auto &block: func.blocks) {
+      for (auto id: block.insts) {
+        auto ops = func.getOperands(id);
+        for (u32 i = 0; i < ops.size(); ++i) {
+          if (func.isValueOperand(id, i)) {
+            users[ops[i]].emplace_back(id, i);
+          }
+        }
+      }
+    }
+    return users;
+  }
+
+  static auto escapes(const Module &module, const Function &func, const Users &users,
+                      ValueId param) -> bool {
+    std::vector<ValueId> worklist{param};
+    std::vector<bool> seen(func.insts.size(), false);
+    seen[param] = true;
+
+    while (!worklist.empty()) {
+      auto value = worklist.back();
+      worklist.pop_back();
+
+      for (auto [user, index]: users[value]) {
+        auto &inst = func.insts[user];
+        switch (inst.op) {
+        case Opcode::Index:
+          if (index != 0) {
+            return true;
+          }
+          break;
+        case Opcode::ICmpEQ:
+        case Opcode::ICmpNE:
+          break;
+        case Opcode::Phi:
+        case Opcode::Copy:
+          if (!seen[user]) {
+            seen[user] = true;
+            worklist.push_back(user);
+          }
+          break;
+        case Opcode::Call: {
+          auto &callee = module.functions[inst.imm];
+          if (index >= callee.noCaptureParams.size() || !callee.noCaptureParams[index]) {
+            return true;
+          }
+          break;
+        }
+        default:
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+};
+
+class MergeBlocks : public Pass {
+public:
+  auto getName() const -> const char * override { return "merge-blocks"; }
+
+  auto run(Module &module) -> bool override {
+    bool changed = false;
+    for (auto &func: module.functions) {
+      if (func.isExtern) {
+        continue;
+      }
+
+      auto preds = func.predecessors();
+      for (auto block: func.reversePostOrder()) {
+        // fold straight-line chains, such as the ones left behind by inlining
+        while (true) {
+          auto term = func.getTerminator(block);
+          if (!term || term->op != Opcode::Br) {
+            break;
+          }
+          auto succ = func.operands[term->firstOperand];
+          if (succ == block || succ == 0 || preds[succ].size() != 1) {
+            break;
+          }
+
+          func.erase(func.blocks[block].insts.back());
+          for (auto id: func.blocks[succ].insts) {
+            auto &inst = func.insts[id];
+            if (inst.op == Opcode::Phi) {
+              // single predecessor, so the phi is just its incoming value
+              inst.op = Opcode::Copy;
+              inst.numOperands = 1;
+            }
+            inst.block = block;
+          }
+          auto &list = func.blocks[block].insts;
+          list.insert(list.end(), func.blocks[succ].insts.begin(),
+                      func.blocks[succ].insts.end());
+          func.blocks[succ].insts.clear();
+
+          for (auto next: func.successors(block)) {
+            std::replace(preds[next].begin(), preds[next].end(), succ, block);
+            for (auto id: func.blocks[next].insts) {
+              if (func.insts[id].op != Opcode::Phi) {
+                continue;
+              }
+              auto ops = func.getOperands(id);
+              for (u32 i = 1; i < ops.size(); i += 2) {
+                if (ops[i] == succ) {
+                  ops[i] = block;
+                }
+              }
+            }
+          }
+          changed = true;
+        }
+      }
+    }
+    return changed;
+  }
+};
+
+class DeadCodeElimination : public Pass {
+  const AttributeInference *attrs;
+
+public:
+  DeadCodeElimination(const AttributeInference *attrs) : attrs(attrs) {}
+
+  auto getName() const -> const char * override { return "dce"; }
+
+  auto run(Module &module) -> bool override {
+    bool changed = false;
+    for (auto &func: module.functions) {
+      if (func.isExtern) {
+        continue;
+      }
+
+      bool progress = true;
+      while (progress) {
+        progress = false;
+        auto uses = func.countUses();
+        for (ValueId id = 0; id < func.insts.size(); ++id) {
+          auto &inst = func.insts[id];
+          if (inst.op == Opcode::Nop || uses[id] != 0 || isTerminator(inst.op)) {
+            continue;
+          }
+          if (inst.op == Opcode::Call && !isPure(module, inst, attrs)) {
+            continue;
+          }
+
+          func.erase(id);
+          progress = true;
+        }
+        changed |= progress;
+      }
+    }
+    return changed;
+  }
+};
+
+} // namespace
+
+auto createCopyPropagationPass() -> std::unique_ptr<Pass> {
+  return std::make_unique<CopyPropagation>();
+}
+
+auto createGVNPass(const AttributeInference *attrs) -> std::unique_ptr<Pass> {
+  return std::make_unique<GVN>(attrs);
+}
+
+auto createInlinerPass(usize threshold) -> std::unique_ptr<Pass> {
+  return std::make_unique<Inliner>(threshold);
+}
+
+auto createBoundsPass() -> std::unique_ptr<Pass> {
+  return std::make_unique<Bounds>();
+}
+
+auto createEscapeAnalysisPass() -> std::unique_ptr<Pass> {
+  return std::make_unique<EscapeAnalysis>();
+}
+
+auto createMergeBlocksPass() -> std::unique_ptr<Pass> {
+  return std::make_unique<MergeBlocks>();
+}
+
+auto createDeadCodeEliminationPass(const AttributeInference *attrs) -> std::unique_ptr<Pass> {
+  return std::make_unique<DeadCodeElimination>(attrs);
+}
+
+} // namespace fern::fir
@@ -0,0 +1,190 @@
+#include "JIT/DiskObjectCache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include "FernConfig.hpp"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace fern {
+
+namespace {
+
+constexpr const char *keyMetadata = "fern.cache.key";
+
+} // namespace
+
+auto DiskObjectCache::defaultDirectory() -> std::string {
+  auto prefix = std::getenv("FERN_PREFIX_DIR");
+  llvm::SmallString<128> path(prefix && *prefix ? prefix : FernPrefixDir);
+  llvm::sys::path::append(path, "cache");
+  return path.str().str();
+}
+
+auto DiskObjectCache::tagModule(llvm::Module &module, llvm::StringRef target, OptLevel level)
+    -> std::string {
+  // the identifiers differ between otherwise identical modules
+  auto id = module.getModuleIdentifier();
+  auto sourceFile = module.getSourceFileName();
+  module.setModuleIdentifier("");
+  module.setSourceFileName("");
+
+  llvm::SmallVector<char, 0> bitcode;
+  llvm::raw_svector_ostream out(bitcode);
+  llvm::WriteBitcodeToFile(module, out);
+
+  module.setModuleIdentifier(id);
+  module.setSourceFileName(sourceFile);
+
+  llvm::SHA1 hash;
+  hash.update(llvm::StringRef(bitcode.data(), bitcode.size()));
+  hash.update(target);
+  hash.update(optLevelName(level));
+  hash.update(FernVersion);
+  auto key = llvm::toHex(hash.final(), true);
+
+  auto &llvmCtx = module.getContext();
+  auto node = module.getOrInsertNamedMetadata(keyMetadata);
+  node->clearOperands();
+  node->addOperand(llvm::MDNode::get(llvmCtx, llvm::MDString::get(llvmCtx, key)));
+  return key;
+}
+
+auto DiskObjectCache::getKey(const llvm::Module &module) -> llvm::StringRef {
+  auto node = module.getNamedMetadata(keyMetadata);
+  if (!node || node->getNumOperands() == 0) {
+    return "";
+  }
+  return llvm::cast<llvm::MDString>(node->getOperand(0)->getOperand(0))->getString();
+}
+
+auto DiskObjectCache::pathFor(llvm::StringRef key) const -> std::string {
+  llvm::SmallString<128> path(dir);
+  llvm::sys::path::append(path, key + ".o");
+  return path.str().str();
+}
+
+auto DiskObjectCache::load(llvm::StringRef key) -> bool {
+  auto path = pathFor(key);
+  int fd;
+  if (llvm::sys::fs::openFileForRead(path, fd)) {
+    misses++;
+    return false;
+  }
+
+  // the modification time doubles as the last use for eviction
+  llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+  auto buffer = llvm::MemoryBuffer::getOpenFile(llvm::sys::fs::convertFDToNativeFile(fd), path,
+                                                -1);
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+  if (!buffer) {
+    misses++;
+    return false;
+  }
+
+  hits++;
+  std::lock_guard lock(loadedMutex);
+  loaded.emplace(key.str(), std::move(*buffer));
+  return true;
+}
+
+auto DiskObjectCache::notifyObjectCompiled(const llvm::Module *module,
+                                           llvm::MemoryBufferRef object) -> void {
+  auto key = getKey(*module);
+  if (key.empty() || llvm::sys::fs::create_directories(dir)) {
+    return;
+  }
+
+  // readers only ever see complete objects
+  int fd;
+  llvm::SmallString<128> tmp;
+  if (llvm::sys::fs::createUniqueFile(dir + "/tmp-%%%%%%%%.o", fd, tmp)) {
+    return;
+  }
+  {
+    // closed here so a failed final flush is seen, a store must never abort the run
+    llvm::raw_fd_ostream out(fd, true);
+    out << object.getBuffer();
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      llvm::sys::fs::remove(tmp);
+      return;
+    }
+  }
+  if (llvm::sys::fs::rename(tmp, pathFor(key))) {
+    llvm::sys::fs::remove(tmp);
+  }
+}
+
+auto DiskObjectCache::getObject(const llvm::Module *module)
+    -> std::unique_ptr<llvm::MemoryBuffer> {
+  auto key = getKey(*module);
+  if (key.empty()) {
+    return nullptr;
+  }
+
+  // only what `load` found, the disk may have changed since and the module was
+  // optimized or not depending on that answer
+  std::lock_guard lock(loadedMutex);
+  auto it = loaded.find(key.str());
+  if (it == loaded.end()) {
+    return nullptr;
+  }
+  auto buffer = std::move(it->second);
+  loaded.erase(it);
+  return buffer;
+}
+
+auto DiskObjectCache::prune() -> void {
+  struct Entry {
+    std::string path;
+    u64 size;
+    llvm::sys::TimePoint<> lastUsed;
+  };
+
+  std::vector<Entry> entries;
+  u64 total = 0;
+  std::error_code ec;
+  for (llvm::sys::fs::directory_iterator it(dir, ec), end; it != end && !ec; it.increment(ec)) {
+    // `tmp-*` files are objects another thread or run is still writing
+    auto name = llvm::sys::path::filename(it->path());
+    if (llvm::sys::path::extension(name) != ".o" || name.startswith("tmp-")) {
+      continue;
+    }
+
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(it->path(), status)) {
+      continue;
+    }
+    entries.push_back(Entry{it->path(), status.getSize(), status.getLastModificationTime()});
+    total += status.getSize();
+  }
+
+  if (total <= maxBytes) {
+    return;
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.lastUsed < b.lastUsed; });
+  for (auto &entry: entries) {
+    if (total <= maxBytes) {
+      break;
+    }
+    if (!llvm::sys::fs::remove(entry.path)) {
+      total -= entry.size;
+      evictions++;
+    }
+  }
+}
+
+} // namespace fern
@@ -0,0 +1,123 @@
+#include "JIT/FernJIT.hpp"
+#include <fmt/format.h>
+#include "Codegen/Optimizer.hpp"
+#include "JIT/PerfSupport.hpp"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h"
+#include "llvm/Support/TargetSelect.h"
+
+namespace fern {
+
+FernJIT::FernJIT(std::unique_ptr<llvm::orc::LLLazyJIT> jit,
+                 std::unique_ptr<DiskObjectCache> cache, OptLevel level, std::string target) :
+    cache(std::move(cache)), jit(std::move(jit)) {
+  // the compile on demand layer hands each function over separately, on first call
+  this->jit->getIRTransformLayer().setTransform(
+      [this, level, target](llvm::orc::ThreadSafeModule tsm,
+                            llvm::orc::MaterializationResponsibility &)
+          -> llvm::Expected<llvm::orc::ThreadSafeModule> {
+        compiledPartitions++;
+        auto err = tsm.withModuleDo([&](llvm::Module &module) -> llvm::Error {
+          // the key has to be taken before optimizing, a cached object replaces both steps.
+          // a hit is loaded here, so the compiler gets the object this decision was made on
+          if (this->cache && cacheableSources.count(module.getSourceFileName()) &&
+              this->cache->load(DiskObjectCache::tagModule(module, target, level))) {
+            return llvm::Error::success();
+          }
+          return Optimizer(level).run(module);
+        });
+        if (err) {
+          return err;
+        }
+        return tsm;
+      });
+}
+
+auto FernJIT::create(OptLevel level, std::unique_ptr<DiskObjectCache> cache, bool perfMap)
+    -> llvm::Expected<std::unique_ptr<FernJIT>> {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!jtmb) {
+    return jtmb.takeError();
+  }
+  // objects are only interchangeable between runs on the same kind of machine
+  auto target = fmt::format("{}/{}/{}", jtmb->getTargetTriple().str(), jtmb->getCPU(),
+                            jtmb->getFeatures().getString());
+
+  llvm::orc::LLLazyJITBuilder builder;
+  builder.setJITTargetMachineBuilder(*jtmb);
+  if (perfMap) {
+    builder.setObjectLinkingLayerCreator(createPerfLinkingLayer());
+  }
+  if (cache) {
+    builder.setCompileFunctionCreator(
+        [cache = cache.get()](llvm::orc::JITTargetMachineBuilder jtmb)
+            -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+          return std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(jtmb), cache);
+        });
+  }
+
+  auto jit = builder.create();
+  if (!jit) {
+    return jit.takeError();
+  }
+
+  auto &dylib = (*jit)->getMainJITDylib();
+  auto host = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      (*jit)->getDataLayout().getGlobalPrefix());
+  if (!host) {
+    return host.takeError();
+  }
+  dylib.addGenerator(std::move(*host));
+
+  return std::unique_ptr<FernJIT>(
+      new FernJIT(std::move(*jit), std::move(cache), level, std::move(target)));
+}
+
+auto FernJIT::addModule(std::unique_ptr<llvm::LLVMContext> context,
+                        std::unique_ptr<llvm::Module> module) -> llvm::Error {
+  cacheableSources.insert(module->getSourceFileName());
+  return jit->addLazyIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context)));
+}
+
+auto FernJIT::runMain(const std::string &programName, const std::vector<std::string> &args,
+                      bool returnsVoid) -> llvm::Expected<int> {
+  auto &dylib = jit->getMainJITDylib();
+  if (auto err = jit->initialize(dylib)) {
+    return err;
+  }
+
+  auto symbol = jit->lookup("main");
+  if (!symbol) {
+    return symbol.takeError();
+  }
+
+  using MainFn = int (*)(int, char *[]);
+  auto result = llvm::orc::runAsMain(reinterpret_cast<MainFn>(symbol->getAddress()), args,
+                                     llvm::StringRef(programName));
+
+  if (auto err = jit->deinitialize(dylib)) {
+    return err;
+  }
+
+  // everything this run needed has been compiled and stored by now
+  if (cache) {
+    cache->prune();
+  }
+  return returnsVoid ? 0 : result;
+}
+
+auto FernJIT::printStats(std::ostream &out) const -> void {
+  out << "JIT:\n";
+  out << fmt::format("  {:<32} {:>10}\n", "lazily compiled partitions", compiledPartitions.load());
+  if (cache) {
+    out << fmt::format("  {:<32} {:>10}\n", "cache hits", cache->getHits());
+    out << fmt::format("  {:<32} {:>10}\n", "cache misses", cache->getMisses());
+    out << fmt::format("  {:<32} {:>10}\n", "cache evictions", cache->getEvictions());
+  }
+}
+
+} // namespace fern
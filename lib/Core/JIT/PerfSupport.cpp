@@ -0,0 +1,84 @@
+#include "JIT/PerfSupport.hpp"
+#include <fmt/format.h>
+#include <mutex>
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace fern {
+
+namespace {
+
+// perf reads `<start> <size> <name>` lines in hex for every JIT'ed function, it has no
+// way of telling when code goes away, so nothing is ever removed
+class PerfMapListener : public llvm::JITEventListener {
+  std::mutex mutex;
+  std::unique_ptr<llvm::raw_fd_ostream> out;
+
+public:
+  static auto get() -> PerfMapListener & {
+    static PerfMapListener listener;
+    return listener;
+  }
+
+  auto notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile &object,
+                          const llvm::RuntimeDyld::LoadedObjectInfo &info) -> void override {
+    // the debug copy of the object has its sections at their load addresses
+    auto debugObject = info.getObjectForDebug(object);
+    if (!debugObject.getBinary()) {
+      return;
+    }
+
+    std::lock_guard lock(mutex);
+    if (!out) {
+      auto path = fmt::format("/tmp/perf-{}.map", llvm::sys::Process::getProcessId());
+      std::error_code ec;
+      out = std::make_unique<llvm::raw_fd_ostream>(path, ec, llvm::sys::fs::OF_Append);
+      if (ec) {
+        llvm::errs() << fmt::format("could not open {}: {}\n", path, ec.message());
+        out.reset();
+        return;
+      }
+    }
+
+    for (auto &[symbol, size]: llvm::object::computeSymbolSizes(*debugObject.getBinary())) {
+      auto type = symbol.getType();
+      if (!type || *type != llvm::object::SymbolRef::ST_Function) {
+        llvm::consumeError(type.takeError());
+        continue;
+      }
+
+      auto name = symbol.getName();
+      auto address = symbol.getAddress();
+      if (!name || !address) {
+        llvm::consumeError(name.takeError());
+        llvm::consumeError(address.takeError());
+        continue;
+      }
+      *out << fmt::format("{:x} {:x} {}\n", *address, size, name->str());
+    }
+    out->flush();
+  }
+};
+
+} // namespace
+
+auto createPerfLinkingLayer() -> llvm::orc::LLJITBuilderState::ObjectLinkingLayerCreator {
+  return [](llvm::orc::ExecutionSession &session, const llvm::Triple &)
+             -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
+    auto layer = std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(
+        session, [] { return std::make_unique<llvm::SectionMemoryManager>(); });
+    layer->registerJITEventListener(PerfMapListener::get());
+    // null when LLVM was built without perf support, the map still works then
+    if (auto jitdump = llvm::JITEventListener::createPerfJITEventListener()) {
+      layer->registerJITEventListener(*jitdump);
+    }
+    return layer;
+  };
+}
+
+} // namespace fern
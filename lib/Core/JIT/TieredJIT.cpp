@@ -0,0 +1,311 @@
+#include "JIT/TieredJIT.hpp"
+#include <chrono>
+#include <fmt/format.h>
+#include "Codegen/Optimizer.hpp"
+#include "JIT/PerfSupport.hpp"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+namespace fern {
+
+namespace {
+
+constexpr const char *tierUpSymbol = "__fern_tier_up";
+constexpr const char *tier0Suffix = ".tier0";
+constexpr const char *tier1Suffix = ".tier1";
+
+auto fernTierUp(void *jit, u32 id) -> void {
+  static_cast<TieredJIT *>(jit)->requestTierUp(id);
+}
+
+auto toCodeGenLevel(OptLevel level) -> llvm::CodeGenOpt::Level {
+  switch (level) {
+  case OptLevel::O0:
+    return llvm::CodeGenOpt::None;
+  case OptLevel::O1:
+    return llvm::CodeGenOpt::Less;
+  case OptLevel::O3:
+    return llvm::CodeGenOpt::Aggressive;
+  default:
+    return llvm::CodeGenOpt::Default;
+  }
+}
+
+} // namespace
+
+TieredJIT::TieredJIT(std::unique_ptr<llvm::orc::LLJIT> jit,
+                     std::unique_ptr<llvm::orc::IndirectStubsManager> stubs,
+                     OptLevel tierUpLevel, u64 threshold) :
+    jit(std::move(jit)), stubs(std::move(stubs)), tierUpLevel(tierUpLevel),
+    threshold(threshold) {
+  worker = std::thread([this] { workerLoop(); });
+}
+
+TieredJIT::~TieredJIT() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+auto TieredJIT::create(OptLevel tierUpLevel, u64 threshold, bool perfMap)
+    -> llvm::Expected<std::unique_ptr<TieredJIT>> {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  // tier 0 bodies are optnone, which codegen honours per function, so the target
+  // machine can be set up for the tier-up level
+  auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!jtmb) {
+    return jtmb.takeError();
+  }
+  jtmb->setCodeGenOptLevel(toCodeGenLevel(tierUpLevel));
+
+  llvm::orc::LLJITBuilder builder;
+  builder.setJITTargetMachineBuilder(std::move(*jtmb));
+  if (perfMap) {
+    builder.setObjectLinkingLayerCreator(createPerfLinkingLayer());
+  }
+
+  auto jit = builder.create();
+  if (!jit) {
+    return jit.takeError();
+  }
+
+  auto host = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      (*jit)->getDataLayout().getGlobalPrefix());
+  if (!host) {
+    return host.takeError();
+  }
+  (*jit)->getMainJITDylib().addGenerator(std::move(*host));
+
+  auto stubs = llvm::orc::createLocalIndirectStubsManagerBuilder((*jit)->getTargetTriple());
+  if (!stubs) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "tiering isn't supported on this target");
+  }
+
+  return std::unique_ptr<TieredJIT>(
+      new TieredJIT(std::move(*jit), stubs(), tierUpLevel, threshold));
+}
+
+auto TieredJIT::instrument(llvm::Module &module) -> void {
+  auto &llvmCtx = module.getContext();
+  auto i32 = llvm::Type::getInt32Ty(llvmCtx);
+  auto i64 = llvm::Type::getInt64Ty(llvmCtx);
+  auto ptr = llvm::Type::getInt8PtrTy(llvmCtx);
+  auto tierUp = module.getOrInsertFunction(
+      tierUpSymbol, llvm::FunctionType::get(llvm::Type::getVoidTy(llvmCtx), {ptr, i32}, false));
+  auto self = llvm::ConstantExpr::getIntToPtr(
+      llvm::ConstantInt::get(i64, reinterpret_cast<uintptr_t>(this)), ptr);
+
+  std::vector<llvm::Function *> defined;
+  for (auto &func: module) {
+    if (!func.isDeclaration()) {
+      defined.push_back(&func);
+    }
+  }
+
+  for (auto func: defined) {
+    auto name = func->getName().str();
+    u32 id = functions.size();
+    functions.push_back(name);
+
+    // callers keep calling `name`, which becomes the stub
+    // internal functions have to be visible for the stub to be pointed at them
+    func->setName(name + tier0Suffix);
+    func->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    auto decl = llvm::Function::Create(func->getFunctionType(),
+                                       llvm::Function::ExternalLinkage, name, module);
+    decl->setAttributes(func->getAttributes());
+    decl->setCallingConv(func->getCallingConv());
+    func->replaceAllUsesWith(decl);
+
+    func->addFnAttr(llvm::Attribute::OptimizeNone);
+    func->addFnAttr(llvm::Attribute::NoInline);
+
+    auto counter = new llvm::GlobalVariable(module, i64, false,
+                                            llvm::GlobalValue::PrivateLinkage,
+                                            llvm::ConstantInt::get(i64, 0), name + ".calls");
+
+    auto &entry = func->getEntryBlock();
+    auto insertPt = entry.getFirstInsertionPt();
+    while (llvm::isa<llvm::AllocaInst>(*insertPt)) {
+      ++insertPt;
+    }
+
+    llvm::IRBuilder<> builder(&entry, insertPt);
+    auto calls = builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, counter,
+                                         llvm::ConstantInt::get(i64, 1), llvm::MaybeAlign(8),
+                                         llvm::AtomicOrdering::Monotonic);
+    auto hot = builder.CreateICmpEQ(calls, llvm::ConstantInt::get(i64, threshold - 1));
+    auto then = llvm::SplitBlockAndInsertIfThen(hot, &*builder.GetInsertPoint(), false);
+    builder.SetInsertPoint(then);
+    builder.CreateCall(tierUp, {self, llvm::ConstantInt::get(i32, id)});
+  }
+}
+
+auto TieredJIT::addModule(std::unique_ptr<llvm::LLVMContext> context,
+                          std::unique_ptr<llvm::Module> module) -> llvm::Error {
+  module->setDataLayout(jit->getDataLayout());
+  {
+    llvm::raw_svector_ostream out(bitcode);
+    llvm::WriteBitcodeToFile(*module, out);
+  }
+
+  instrument(*module);
+
+  auto &dylib = jit->getMainJITDylib();
+  llvm::orc::SymbolMap symbols;
+  symbols[jit->mangleAndIntern(tierUpSymbol)] =
+      llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&fernTierUp),
+                               llvm::JITSymbolFlags::Exported);
+
+  // stubs are created pointing nowhere, tier 0 bodies need them to link
+  llvm::orc::IndirectStubsManager::StubInitsMap inits;
+  for (auto &name: functions) {
+    inits[name] = {0, llvm::JITSymbolFlags::Exported};
+  }
+  if (auto err = stubs->createStubs(inits)) {
+    return err;
+  }
+  for (auto &name: functions) {
+    symbols[jit->mangleAndIntern(name)] = stubs->findStub(name, false);
+  }
+  if (auto err = dylib.define(llvm::orc::absoluteSymbols(std::move(symbols)))) {
+    return err;
+  }
+
+  if (auto err = jit->addIRModule(
+          llvm::orc::ThreadSafeModule(std::move(module), std::move(context)))) {
+    return err;
+  }
+
+  for (auto &name: functions) {
+    auto body = jit->lookup(name + tier0Suffix);
+    if (!body) {
+      return body.takeError();
+    }
+    if (auto err = stubs->updatePointer(name, body->getAddress())) {
+      return err;
+    }
+  }
+  return llvm::Error::success();
+}
+
+auto TieredJIT::requestTierUp(u32 id) -> void {
+  {
+    std::lock_guard lock(mutex);
+    queue.push_back(id);
+  }
+  wake.notify_one();
+}
+
+auto TieredJIT::workerLoop() -> void {
+  while (true) {
+    u32 id;
+    {
+      std::unique_lock lock(mutex);
+      wake.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (stopping) {
+        return;
+      }
+      id = queue.front();
+      queue.pop_front();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto err = recompile(id);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::lock_guard lock(mutex);
+    if (err) {
+      failures.push_back(fmt::format("{}: {}", functions[id], llvm::toString(std::move(err))));
+    } else {
+      tierUps.push_back(TierUp{functions[id], elapsed.count()});
+    }
+  }
+}
+
+auto TieredJIT::recompile(u32 id) -> llvm::Error {
+  auto &name = functions[id];
+
+  auto context = std::make_unique<llvm::LLVMContext>();
+  auto buffer = llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), name);
+  auto module = llvm::parseBitcodeFile(buffer, *context);
+  if (!module) {
+    return module.takeError();
+  }
+
+  // everything else stays reachable through its stub, but may still be inlined
+  for (auto &func: **module) {
+    if (!func.isDeclaration() && func.getName() != name) {
+      func.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+    }
+  }
+  auto func = (*module)->getFunction(name);
+  func->setName(name + tier1Suffix);
+  func->setLinkage(llvm::GlobalValue::ExternalLinkage);
+
+  if (auto err = Optimizer(tierUpLevel).run(**module)) {
+    return err;
+  }
+
+  if (auto err = jit->addIRModule(
+          llvm::orc::ThreadSafeModule(std::move(*module), std::move(context)))) {
+    return err;
+  }
+
+  auto body = jit->lookup(name + tier1Suffix);
+  if (!body) {
+    return body.takeError();
+  }
+  return stubs->updatePointer(name, body->getAddress());
+}
+
+auto TieredJIT::runMain(const std::string &programName, const std::vector<std::string> &args,
+                        bool returnsVoid) -> llvm::Expected<int> {
+  auto &dylib = jit->getMainJITDylib();
+  if (auto err = jit->initialize(dylib)) {
+    return err;
+  }
+
+  auto symbol = jit->lookup("main");
+  if (!symbol) {
+    return symbol.takeError();
+  }
+
+  using MainFn = int (*)(int, char *[]);
+  auto result = llvm::orc::runAsMain(reinterpret_cast<MainFn>(symbol->getAddress()), args,
+                                     llvm::StringRef(programName));
+
+  if (auto err = jit->deinitialize(dylib)) {
+    return err;
+  }
+  return returnsVoid ? 0 : result;
+}
+
+auto TieredJIT::printStats(std::ostream &out) const -> void {
+  std::lock_guard lock(mutex);
+  out << "JIT:\n";
+  out << fmt::format("  {:<32} {:>10}\n", "functions", functions.size());
+  out << fmt::format("  {:<32} {:>10}\n", "tier-up threshold", threshold);
+  out << fmt::format("  {:<32} {:>10}\n", "tier-ups", tierUps.size());
+  for (auto &tierUp: tierUps) {
+    out << fmt::format("    {:<30} {:>10.3f} ms\n", tierUp.name, tierUp.compileMs);
+  }
+  for (auto &failure: failures) {
+    out << fmt::format("  tier-up failed: {}\n", failure);
+  }
+}
+
+} // namespace fern
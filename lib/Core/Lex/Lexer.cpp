@@ -257,6 +257,8 @@ auto Lexer::lexOperatorOrComment() -> std::optional<Token> {
       return Token(TokenKind::RBracket, "]", start);
     case '&':
       return Token(TokenKind::Ref, "&", start);
+    case '@':
+      return Token(TokenKind::At, "@", start);
     default:
       context.recordError("Unexpected character", start);
       return std::nullopt;
@@ -26,6 +26,8 @@ auto tokenKindToString(TokenKind kind) -> std::string {
     return "Semicolon";
   case TokenKind::Ref:
     return "Ref";
+  case TokenKind::At:
+    return "At";
 
   case TokenKind::Plus:
     return "Plus";
@@ -8,6 +8,16 @@ auto Parser::parse() -> std::shared_ptr<ProgramNode> {
   
 
   while (!tokens.isEof()) {
+    auto annotations = parseAnnotations();
+    if (!annotations) {
+      return nullptr;
+    }
+
+    if (tokens.isEof()) {
+      ctx.recordError("expected `func` or `extern` after annotation", annotations->back().loc);
+      return nullptr;
+    }
+
     switch (tokens.peek()->getKind()) {
     case TokenKind::Func: {
       auto func = parseFunction();
@@ -15,6 +25,7 @@ auto Parser::parse() -> std::shared_ptr<ProgramNode> {
         return nullptr;
       }
 
+      func->getProto()->setAnnotations(*annotations);
       program->addFunction(func);
       break;
     }
@@ -24,6 +35,7 @@ auto Parser::parse() -> std::shared_ptr<ProgramNode> {
         return nullptr;
       }
 
+      ext->getProto()->setAnnotations(*annotations);
       program->addExtern(ext);
       break;
     }
@@ -40,6 +52,52 @@ auto Parser::parse() -> std::shared_ptr<ProgramNode> {
   return program;
 }
 
+auto Parser::parseAnnotations() -> std::optional<std::vector<Annotation>> {
+  std::vector<Annotation> annotations;
+
+  while (!tokens.isEof() && tokens.peek()->getKind() == TokenKind::At) {
+    auto loc = tokens.next()->getLocation();
+
+    if (tokens.peek()->getKind() != TokenKind::Ident) {
+      ctx.recordError("unexpected token, expected annotation name", tokens.peek()->getLocation());
+      return std::nullopt;
+    }
+    auto name = *tokens.next();
+
+    std::vector<std::string> args;
+    if (tokens.peek()->getKind() == TokenKind::LParen) {
+      tokens.next();
+
+      while (tokens.peek()->getKind() != TokenKind::RParen) {
+        switch (tokens.peek()->getKind()) {
+        case TokenKind::String:
+        case TokenKind::Integer:
+        case TokenKind::Float:
+        case TokenKind::Ident:
+          args.push_back(tokens.next()->getLexeme());
+          break;
+        default:
+          ctx.recordError("unexpected token, expected annotation argument",
+                          tokens.peek()->getLocation());
+          return std::nullopt;
+        }
+
+        if (tokens.peek()->getKind() == TokenKind::Comma) {
+          tokens.next();
+        } else if (tokens.peek()->getKind() != TokenKind::RParen) {
+          ctx.recordError("unexpected token, expected `,` or `)`", tokens.peek()->getLocation());
+          return std::nullopt;
+        }
+      }
+      tokens.next();
+    }
+
+    annotations.emplace_back(name.getLexeme(), args, loc);
+  }
+
+  return annotations;
+}
+
 auto Parser::parseFunctionPrototype() -> std::shared_ptr<Prototype> {
   auto loc = tokens.peek()->getLocation();
 
@@ -153,6 +211,7 @@ auto Parser::parseExternDef() -> std::shared_ptr<ExternDef> {
   }
   tokens.next();
 
+  proto->setExtern(true);
   return std::make_shared<ExternDef>(proto);
 }
 
@@ -295,14 +354,11 @@ auto Parser::parseParenExpr() -> std::shared_ptr<AstNode> {
 auto Parser::parseIdentifierExpr() -> std::shared_ptr<AstNode> {
   auto ident = *tokens.next();
 
-  std::cout << "peeked token: " << tokens.peek()->toString() << "\n";
   if (tokens.peek()->getKind() != TokenKind::LParen && tokens.peek()->getKind() != TokenKind::LBracket) {
     return std::make_shared<VariableNode>(ident.getLocation(), ident.getLexeme());
   }
-  tokens.next();
 
-  if (tokens.peek()->getKind() == TokenKind::LBracket) {
-    std::cout << "parsing subscript\n";
+  if (tokens.next()->getKind() == TokenKind::LBracket) {
     auto index = parseExpr();
     if (!index) {
       ctx.recordError("failed to parse index expression", tokens.peek()->getLocation());
@@ -439,6 +495,11 @@ auto Parser::parseIfExpr() -> std::shared_ptr<AstNode> {
     return nullptr;
   }
 
+  auto thenAnnotations = parseAnnotations();
+  if (!thenAnnotations) {
+    return nullptr;
+  }
+
   if (tokens.peek()->getKind() != TokenKind::LBrace) {
     ctx.recordError("expected `{`", tokens.peek()->getLocation());
     return nullptr;
@@ -451,9 +512,16 @@ auto Parser::parseIfExpr() -> std::shared_ptr<AstNode> {
 
   auto hasElse = false;
   std::shared_ptr<AstNode> elseBlock = nullptr;
+  std::vector<Annotation> elseAnnotations;
   if (tokens.peek()->getKind() == TokenKind::Else) {
     tokens.next();
 
+    auto annotations = parseAnnotations();
+    if (!annotations) {
+      return nullptr;
+    }
+    elseAnnotations = std::move(*annotations);
+
     if (tokens.peek()->getKind() != TokenKind::LBrace) {
       ctx.recordError("expected `{`", tokens.peek()->getLocation());
       return nullptr;
@@ -467,7 +535,10 @@ auto Parser::parseIfExpr() -> std::shared_ptr<AstNode> {
     hasElse = true;
   }
 
-  return std::make_shared<IfNode>(cond->getLocation(), cond, ifBlock, elseBlock);
+  auto node = std::make_shared<IfNode>(cond->getLocation(), cond, ifBlock, elseBlock);
+  node->setThenAnnotations(std::move(*thenAnnotations));
+  node->setElseAnnotations(std::move(elseAnnotations));
+  return node;
 }
 
 auto Parser::parseBlockExpr() -> std::shared_ptr<AstNode> {
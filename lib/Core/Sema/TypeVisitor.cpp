@@ -1,6 +1,7 @@
 #include "Sema/TypeVisitor.hpp"
 #include "AST/Nodes.hpp"
 #include "Errors/Context.hpp"
+#include "Support/OptLevel.hpp"
 
 namespace fern {
 
@@ -32,7 +33,30 @@ auto TypeVisitor::visit(Function &node) -> void {
   checkCtx.currentFunction = std::nullopt;
 }
 
-auto TypeVisitor::visit(ExternDef &node) -> void { node.getProto()->typeCheck(*this); }
+// annotations that only change a function's definition, which an extern doesn't have
+static constexpr const char *definitionAnnotations[] = {
+  "export", "optimize", "fastmath", "target_clones", "hot", "cold",
+};
+
+auto TypeVisitor::visit(ExternDef &node) -> void {
+  node.getProto()->typeCheck(*this);
+
+  for (auto name: definitionAnnotations) {
+    if (auto annotation = node.getProto()->getAnnotation(name)) {
+      ctx.recordWarning(fmt::format("`@{}` has no effect on an extern", name), annotation->loc);
+    }
+  }
+}
+
+// known annotations and the number of arguments they take, -1 for any
+static const std::unordered_map<std::string, int> knownAnnotations = {
+  {"export", 0},
+  {"optimize", 1},
+  {"fastmath", 0},
+  {"target_clones", -1},
+  {"hot", 0},
+  {"cold", 0},
+};
 
 auto TypeVisitor::visit(Prototype &node) -> void {
   auto duplicate = lookupFunction(node.getName());
@@ -40,6 +64,39 @@ auto TypeVisitor::visit(Prototype &node) -> void {
     ctx.recordError("duplicate function name", node.getLocation());
   }
 
+  for (auto &annotation: node.getAnnotations()) {
+    auto known = knownAnnotations.find(annotation.name);
+    if (known == knownAnnotations.end()) {
+      ctx.recordError(fmt::format("unknown annotation `@{}`", annotation.name), annotation.loc);
+      continue;
+    }
+
+    if (known->second >= 0 && annotation.args.size() != static_cast<usize>(known->second)) {
+      ctx.recordError(fmt::format("`@{}` expects {} argument{}", annotation.name, known->second,
+                                  known->second == 1 ? "" : "s"),
+                      annotation.loc);
+      continue;
+    }
+
+    if (annotation.name == "optimize" && !parseOptLevel(annotation.args[0])) {
+      ctx.recordError(fmt::format("unknown optimization level `{}`", annotation.args[0]),
+                      annotation.loc);
+      ctx.recordNote("expected one of O0, O1, O2, O3, Os or Oz");
+    }
+
+    if (annotation.name == "target_clones" &&
+        std::find(annotation.args.begin(), annotation.args.end(), "default") ==
+            annotation.args.end()) {
+      ctx.recordError("`@target_clones` needs a `default` version", annotation.loc);
+      ctx.recordNote("it's used on CPUs without any of the listed features");
+    }
+  }
+
+  if (node.hasAnnotation("hot") && node.hasAnnotation("cold")) {
+    ctx.recordError("a function can't be both `@hot` and `@cold`",
+                    node.getAnnotation("cold")->loc);
+  }
+
   funcSymbolTable.emplace(node.getName(),
                           FunctionType(node.getArgTypes(), node.getReturnType()));
 }
@@ -140,6 +197,33 @@ auto TypeVisitor::visit(IfNode &node) -> void {
     ctx.recordError("if condition must be a boolean", node.getLocation());
   }
 
+  // returns the branch's hint, if it has a valid one
+  auto checkBranch = [&](const std::vector<Annotation> &annotations) -> const Annotation * {
+    const Annotation *hint = nullptr;
+    for (auto &annotation: annotations) {
+      if (annotation.name != "likely" && annotation.name != "unlikely") {
+        ctx.recordError(fmt::format("unknown branch annotation `@{}`", annotation.name),
+                        annotation.loc);
+        ctx.recordNote("branches only take `@likely` or `@unlikely`");
+      } else if (!annotation.args.empty()) {
+        ctx.recordError(fmt::format("`@{}` expects 0 arguments", annotation.name),
+                        annotation.loc);
+      } else if (hint && hint->name != annotation.name) {
+        ctx.recordError("a branch can't be both `@likely` and `@unlikely`", annotation.loc);
+      } else {
+        hint = &annotation;
+      }
+    }
+    return hint;
+  };
+  auto thenHint = checkBranch(node.getThenAnnotations());
+  auto elseHint = checkBranch(node.getElseAnnotations());
+  if (thenHint && elseHint && thenHint->name == elseHint->name) {
+    ctx.recordError(fmt::format("both branches of the if are `@{}`", elseHint->name),
+                    elseHint->loc);
+    ctx.recordNote("a hint on one branch already implies the opposite for the other");
+  }
+
   node.getThenBlock()->typeCheck(*this);
 
   if (node.hasElseBlock()) {
@@ -222,6 +306,10 @@ auto TypeVisitor::visit(CallNode &node) -> void {
     return;
   }
 
+  for (auto &arg: node.getArgs()) {
+    arg->typeCheck(*this);
+  }
+
   for (usize i = 0; i < func->getArity(); ++i) {
     if (func->paramTypes[i] != node.getArgs()[i]->getType()) {
       ctx.recordError("incorrect argument type", node.getLocation());
@@ -256,7 +344,7 @@ auto TypeVisitor::visit(SubscriptNode &node) -> void {
     return;
   }
 
-  node.setType(node.getOperand()->getType().deref());
+  node.setType(node.getIndexedType());
 }
 
 auto TypeVisitor::visit(BooleanNode &node) -> void {
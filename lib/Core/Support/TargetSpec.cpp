@@ -0,0 +1,37 @@
+#include "Support/TargetSpec.hpp"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/Host.h"
+
+namespace fern {
+
+auto TargetSpec::setArch(std::string_view arch) -> void {
+  if (arch != "native") {
+    cpu = arch;
+    return;
+  }
+
+  cpu = llvm::sys::getHostCPUName().str();
+  llvm::StringMap<bool> hostFeatures;
+  if (!llvm::sys::getHostCPUFeatures(hostFeatures)) {
+    return;
+  }
+
+  llvm::SubtargetFeatures subtarget;
+  for (auto &feature: hostFeatures) {
+    subtarget.AddFeature(feature.first(), feature.second);
+  }
+  addFeatures(subtarget.getString());
+}
+
+auto TargetSpec::addFeatures(std::string_view attrs) -> void {
+  if (attrs.empty()) {
+    return;
+  }
+  if (!features.empty()) {
+    features += ',';
+  }
+  features += attrs;
+}
+
+} // namespace fern
@@ -2,28 +2,204 @@
 #include <cxxopts.hpp>
 #include <fmt/format.h>
 #include <iostream>
+#include "Analysis/AttributeInference.hpp"
+#include "Analysis/DeadDeclElimination.hpp"
 #include "Errors/Context.hpp"
 #include "Errors/FancyPrinter.hpp"
+#include "FIR/ASTLowering.hpp"
+#include "FIR/LLVMLowering.hpp"
+#include "FIR/Passes.hpp"
 #include "FernConfig.hpp"
+#include "JIT/FernJIT.hpp"
+#include "JIT/TieredJIT.hpp"
 #include "Parse/Lex/Lexer.hpp"
 #include "Parse/Parser.hpp"
 #include "Sema/TypeVisitor.hpp"
 #include "Codegen/CodegenVisitor.hpp"
+#include "Codegen/DebugInfo.hpp"
+#include "Codegen/Emitter.hpp"
+#include "Codegen/FunctionLayout.hpp"
+#include "Codegen/Multiversioning.hpp"
+#include "Codegen/Optimizer.hpp"
+#include "Codegen/ParallelBackend.hpp"
+#include "Codegen/ProfileRuntime.hpp"
+#include "Codegen/Remarks.hpp"
+#include "Codegen/ThinLTO.hpp"
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Program.h"
 
 #define hasDebugPass(pass) (optRes.count("pass-debug") && std::find(optRes["pass-debug"].as<std::vector<std::string>>().begin(), optRes["pass-debug"].as<std::vector<std::string>>().end(), pass) != optRes["pass-debug"].as<std::vector<std::string>>().end())
 
+// `fern link <inputs>... [options]` runs the ThinLTO backend over units compiled with
+// `--lto=thin` and links them with any other objects into an executable
+auto linkMain(int argc, char **argv) -> int {
+  cxxopts::Options opts("fern link", "Link files compiled with `--lto=thin` into an executable");
+  opts.add_options()("h,help", "Print this help text")(
+      "inputs", "Bitcode from `--lto=thin`, objects and other `cc` arguments",
+      cxxopts::value<std::vector<std::string>>());
+  opts.add_options()("o,output", "Output file",
+                     cxxopts::value<std::string>()->default_value("a.out"), "<file>");
+  opts.add_options()("O,opt-level", "Optimization level the units are finished at: 0, 1, 2, "
+                                    "3, s or z",
+                     cxxopts::value<std::string>()->default_value("2"), "<level>");
+  opts.add_options()("j,jobs", "Units optimized and compiled at once, 0 for one per core",
+                     cxxopts::value<u32>()->default_value("0"), "<n>");
+  opts.add_options()("lto-cache", "Directory compiled units are cached in",
+                     cxxopts::value<std::string>()->default_value(
+                         fern::ThinLTOLinker::defaultCacheDirectory()),
+                     "<dir>");
+  opts.add_options()("no-cache", "Don't load or store compiled units in the cache");
+  opts.add_options()("cache-size", "Size the cache is pruned to, in MiB",
+                     cxxopts::value<u64>()->default_value("512"), "<MiB>");
+  opts.add_options()("stats", "Print timings and cache hits");
+  opts.parse_positional({"inputs"});
+  opts.positional_help("<inputs>...");
+  auto optRes = opts.parse(argc, argv);
+
+  if (optRes.count("help") || !optRes.count("inputs")) {
+    std::cout << opts.help() << std::endl;
+    return 0;
+  }
+
+  auto optLevel = fern::parseOptLevel(optRes["opt-level"].as<std::string>());
+  if (!optLevel) {
+    std::cerr << fmt::format("Unknown optimization level: -O{}",
+                             optRes["opt-level"].as<std::string>())
+              << std::endl;
+    return 1;
+  }
+
+  fern::Statistics stats;
+  fern::ThinLTOLinker linker(*optLevel, optRes["jobs"].as<u32>());
+  if (!optRes.count("no-cache")) {
+    linker.setCache(optRes["lto-cache"].as<std::string>(), optRes["cache-size"].as<u64>() << 20);
+  }
+
+  auto ofile = optRes["output"].as<std::string>();
+  {
+    auto timer = stats.time("thin link");
+    if (auto err = linker.run(optRes["inputs"].as<std::vector<std::string>>(), ofile)) {
+      std::cerr << fmt::format("Failed to write {}: {}", ofile, llvm::toString(std::move(err)))
+                << std::endl;
+      return 1;
+    }
+  }
+
+  if (optRes.count("stats")) {
+    stats.addCounter("thin LTO units", linker.getUnits());
+    stats.addCounter("thin LTO cache hits", linker.getCacheHits());
+    stats.print(std::cerr);
+  }
+  return 0;
+}
+
 auto main(int argc, char **argv) -> int {
+  if (argc > 1 && std::string_view(argv[1]) == "link") {
+    return linkMain(argc - 1, argv + 1);
+  }
+
   cxxopts::Options opts("fern", fmt::format("Fern Compiler v{}", FernVersion));
   opts.allow_unrecognised_options();
   opts.add_options()("v,version", "Print version information")(
       "h,help", "Print this help text")("ifile", "File to compile",
                                         cxxopts::value<std::string>());
 
+  opts.add_options()("check", "Only lex, parse and type check the input, then exit");
+  opts.add_options()("keep-all", "Keep functions and externs unreachable from `main` and "
+                                 "`@export`ed functions");
+  opts.add_options("Optimization")("O,opt-level", "Optimization level: 0, 1, 2, 3, s or z",
+                                    cxxopts::value<std::string>()->default_value("0"), "<level>");
+  opts.add_options("Optimization")("passes", "Run a custom LLVM pass pipeline instead of the "
+                                             "`-O` one, e.g. `function(instcombine,gvn)`",
+                                   cxxopts::value<std::string>(), "<pipeline>");
+  opts.add_options("Optimization")("j,jobs", "Optimize and compile the program as this many "
+                                             "partitions in parallel",
+                                   cxxopts::value<u32>()->default_value("1"), "<n>");
+  opts.add_options("Optimization")("fast-math", "Let float math be reassociated, contracted "
+                                                "and assume no NaNs or infinities, like "
+                                                "`@fastmath` on every function");
+  opts.add_options("Optimization")("profile-generate", "Count how often blocks run and write "
+                                                      "the counts to this file at exit, "
+                                                      "`$LLVM_PROFILE_FILE` overrides it",
+                                   cxxopts::value<std::string>()->implicit_value(
+                                       "default.profraw"),
+                                   "<file>");
+  opts.add_options("Optimization")("profile-use", "Optimize with a profile merged by "
+                                                  "`llvm-profdata merge`",
+                                   cxxopts::value<std::string>(), "<file.profdata>");
+  opts.add_options("Optimization")("remarks", "Report what the optimizer did at the Fern "
+                                              "source it did it to: passed, missed or analysis",
+                                   cxxopts::value<std::vector<std::string>>(), "<kinds>");
+  opts.add_options("Optimization")("remarks-filter", "Only report remarks from passes "
+                                                     "matching this regex, e.g. `inline`",
+                                   cxxopts::value<std::string>(), "<regex>");
+  opts.add_options("Optimization")("remarks-output", "Also write the remarks to this file",
+                                   cxxopts::value<std::string>(), "<file>");
+  opts.add_options("Optimization")("remarks-format", "Format of `--remarks-output`: yaml "
+                                                     "or bitstream",
+                                   cxxopts::value<std::string>()->default_value("yaml"),
+                                   "<format>");
+  opts.add_options("Optimization")("lto", "Link-time optimization across files. `thin` "
+                                   "writes objects with a module summary, to be linked with "
+                                   "`fern link`",
+                                   cxxopts::value<std::string>(), "<mode>");
+  opts.add_options("Optimization")("symbol-order", "Write the hot functions, hottest first, "
+                                                   "to this file for a linker's "
+                                                   "`--symbol-ordering-file`",
+                                   cxxopts::value<std::string>(), "<file>");
+  opts.add_options("Target")("target", "Target triple to generate code for, the host if unset",
+                             cxxopts::value<std::string>(), "<triple>");
+  opts.add_options("Target")("march", "CPU to generate code for, `native` for the host CPU "
+                                      "and all of its features",
+                             cxxopts::value<std::string>(), "<cpu>");
+  opts.add_options("Target")("mcpu", "CPU to generate code for, overrides `--march`",
+                             cxxopts::value<std::string>(), "<cpu>");
+  opts.add_options("Target")("mattr", "Target features to enable or disable, e.g. "
+                                      "`+avx2,-avx512f`",
+                             cxxopts::value<std::string>(), "<features>");
+  opts.add_options("Output")("o,output", "Output file, `-` for stdout",
+                             cxxopts::value<std::string>(), "<file>");
+  opts.add_options("Output")("g,debug", "Emit DWARF debug info with functions, locals and "
+                                       "line tables");
+  opts.add_options("Output")("gline-tables-only", "Emit only the line tables, enough for "
+                                                  "profilers to map code back to source");
+  opts.add_options("Output")("emit", "Kind of output: exe, obj, asm, bc or ll",
+                             cxxopts::value<std::string>()->default_value("exe"), "<kind>");
+  opts.add_options("Run")("tiered", "Start every function at -O0 and recompile hot ones in "
+                                    "the background at the -O level (O2 if unset)");
+  opts.add_options("Run")("tier-up-threshold", "Calls before a function is recompiled",
+                          cxxopts::value<u64>()->default_value("1000"), "<calls>");
+  opts.add_options("Run")("no-cache", "Don't load or store compiled code in the object cache");
+  opts.add_options("Run")("cache-size", "Size the object cache is pruned to, in MiB",
+                          cxxopts::value<u64>()->default_value("512"), "<MiB>");
+  opts.add_options("Run")("perf-map", "Let `perf` name JIT-compiled functions through "
+                                      "/tmp/perf-<pid>.map, and write jitdump files with "
+                                      "line tables for `perf inject --jit`");
+  opts.add_options("Run")("jit-stats", "Print what the JIT compiled once the program exits");
+  opts.add_options()("fir", "Lower through Fern's mid-level IR and its passes before LLVM");
+  opts.add_options()("fast", "Tune for compile speed: drop IR value names, use FastISel at "
+                             "-O0 and only verify functions in debug builds of fern");
+
 
-  opts.add_options("Debug")("pass-debug", "Print debug information for specified passes", cxxopts::value<std::vector<std::string>>(), "[lex,parse,codegen]");
+  opts.add_options("Debug")("pass-debug", "Print debug information for specified passes", cxxopts::value<std::vector<std::string>>(), "[lex,parse,fir,codegen]");
+  opts.add_options("Debug")("stats", "Print timings and counters for each compilation phase");
 
   opts.parse_positional({"ifile"});
-  auto optRes = opts.parse(argc, argv);
+  opts.positional_help("[run|link] <file> [-- <args>...]");
+
+  // `fern run <file> [options] -- <args>...` JIT compiles the program and runs it
+  bool runMode = argc > 1 && std::string_view(argv[1]) == "run";
+  std::vector<const char *> compilerArgs{argv[0]};
+  std::vector<std::string> programArgs;
+  for (int i = runMode ? 2 : 1; i < argc; ++i) {
+    if (runMode && std::string_view(argv[i]) == "--") {
+      programArgs.assign(argv + i + 1, argv + argc);
+      break;
+    }
+    compilerArgs.push_back(argv[i]);
+  }
+  auto optRes = opts.parse(compilerArgs.size(), compilerArgs.data());
 
   if (optRes.count("help") || optRes.arguments().empty()) {
     std::cout << opts.help() << std::endl;
@@ -35,6 +211,114 @@ auto main(int argc, char **argv) -> int {
     return 0;
   }
 
+  auto optLevel = fern::parseOptLevel(optRes["opt-level"].as<std::string>());
+  if (!optLevel) {
+    std::cerr << fmt::format("Unknown optimization level: -O{}",
+                             optRes["opt-level"].as<std::string>())
+              << std::endl;
+    return 1;
+  }
+
+  auto emitKind = fern::parseEmitKind(optRes["emit"].as<std::string>());
+  if (!emitKind) {
+    std::cerr << fmt::format("Unknown output kind: {}", optRes["emit"].as<std::string>())
+              << std::endl;
+    return 1;
+  }
+
+  bool thinLTO = false;
+  if (optRes.count("lto")) {
+    if (optRes["lto"].as<std::string>() != "thin") {
+      std::cerr << fmt::format("Unknown LTO mode: {}", optRes["lto"].as<std::string>())
+                << std::endl;
+      return 1;
+    } else if (runMode) {
+      std::cerr << "`--lto` can't be used with `fern run`" << std::endl;
+      return 1;
+    } else if (*emitKind != fern::EmitKind::Object && *emitKind != fern::EmitKind::Executable) {
+      std::cerr << "`--lto=thin` only writes objects and executables" << std::endl;
+      return 1;
+    }
+    thinLTO = true;
+  }
+
+  if (optRes.count("debug") && optRes.count("gline-tables-only")) {
+    std::cerr << "`-g` and `--gline-tables-only` can't be used together" << std::endl;
+    return 1;
+  }
+
+  fern::ProfileOptions profile;
+  if (optRes.count("profile-generate") && optRes.count("profile-use")) {
+    std::cerr << "`--profile-generate` and `--profile-use` can't be used together" << std::endl;
+    return 1;
+  } else if (runMode && (optRes.count("profile-generate") || optRes.count("profile-use"))) {
+    std::cerr << "Profiles can't be used with `fern run`" << std::endl;
+    return 1;
+  } else if (optRes.count("profile-generate")) {
+    profile = {fern::ProfileOptions::Mode::Generate, optRes["profile-generate"].as<std::string>()};
+  } else if (optRes.count("profile-use")) {
+    profile = {fern::ProfileOptions::Mode::Use, optRes["profile-use"].as<std::string>()};
+    if (!llvm::sys::fs::exists(profile.path)) {
+      std::cerr << fmt::format("Profile not found: {}", profile.path) << std::endl;
+      return 1;
+    }
+  }
+
+  std::unique_ptr<fern::RemarkCollector> remarks;
+  auto remarksFormat = llvm::remarks::Format::YAML;
+  if (optRes.count("remarks")) {
+    if (runMode) {
+      std::cerr << "`--remarks` can't be used with `fern run`" << std::endl;
+      return 1;
+    }
+
+    std::vector<fern::RemarkKind> kinds;
+    for (auto &name: optRes["remarks"].as<std::vector<std::string>>()) {
+      auto kind = fern::parseRemarkKind(name);
+      if (!kind) {
+        std::cerr << fmt::format("Unknown remark kind: {}", name) << std::endl;
+        return 1;
+      }
+      kinds.push_back(*kind);
+    }
+
+    auto filter = optRes.count("remarks-filter") ? optRes["remarks-filter"].as<std::string>()
+                                                 : "";
+    auto created = fern::RemarkCollector::create(std::move(kinds), filter);
+    if (!created) {
+      std::cerr << llvm::toString(created.takeError()) << std::endl;
+      return 1;
+    }
+    remarks = std::move(*created);
+    remarks->setHotness(profile.mode == fern::ProfileOptions::Mode::Use);
+
+    auto format = llvm::remarks::parseFormat(optRes["remarks-format"].as<std::string>());
+    if (!format) {
+      std::cerr << llvm::toString(format.takeError()) << std::endl;
+      return 1;
+    }
+    remarksFormat = *format;
+  }
+
+  fern::TargetSpec targetSpec;
+  if (optRes.count("target")) {
+    if (runMode) {
+      std::cerr << "`--target` can't be used with `fern run`, the JIT always targets the host"
+                << std::endl;
+      return 1;
+    }
+    targetSpec.triple = optRes["target"].as<std::string>();
+  }
+  if (optRes.count("march")) {
+    targetSpec.setArch(optRes["march"].as<std::string>());
+  }
+  if (optRes.count("mcpu")) {
+    targetSpec.cpu = optRes["mcpu"].as<std::string>();
+  }
+  if (optRes.count("mattr")) {
+    targetSpec.addFeatures(optRes["mattr"].as<std::string>());
+  }
+
   auto ifile = optRes["ifile"].as<std::string>();
 
   auto res = roots::fs::readFile(ifile);
@@ -50,11 +334,17 @@ auto main(int argc, char **argv) -> int {
   }
 
   auto source = res.value();
+  auto start = std::chrono::steady_clock::now();
   fern::Context ctx(source, ifile);
+  ctx.setTargetSpec(targetSpec);
   fern::Lexer lexer(ctx);
   fern::FancyErrorPrinter errPrinter(source, ifile);
 
-  auto lexRes = lexer.lex();
+  bool lexRes;
+  {
+    auto timer = ctx.getStats().time("lex");
+    lexRes = lexer.lex();
+  }
   if (!lexRes) {
     ctx.printErrors(errPrinter);
 
@@ -70,7 +360,11 @@ auto main(int argc, char **argv) -> int {
   }
 
   fern::Parser parser(lexer.getTokens(), ctx);
-  auto parsedProgram = parser.parse();
+  std::shared_ptr<fern::ProgramNode> parsedProgram;
+  {
+    auto timer = ctx.getStats().time("parse");
+    parsedProgram = parser.parse();
+  }
 
   if (!parsedProgram) {
     ctx.printErrors(errPrinter);
@@ -83,8 +377,48 @@ auto main(int argc, char **argv) -> int {
     parsedProgram->print(llvm::outs(), 0);
   }
 
+  fern::DeadDeclStats deadDecls;
+  // `--check` reports errors in every declaration, reachable or not
+  if (!optRes.count("keep-all") && !optRes.count("check")) {
+    auto timer = ctx.getStats().time("reachability");
+    deadDecls = fern::eliminateDeadDecls(*parsedProgram);
+  }
+
+  auto printStats = [&] {
+    if (!optRes.count("stats")) {
+      return;
+    }
+
+    auto &stats = ctx.getStats();
+    stats.addCounter("unreachable functions removed", deadDecls.removedFunctions);
+    stats.addCounter("unreachable externs removed", deadDecls.removedExterns);
+
+    // compile time per line is the number `--fast` is tuned and benchmarked against
+    auto lines = std::count(source.begin(), source.end(), '\n') +
+                 (!source.empty() && source.back() != '\n');
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    auto total = elapsed.count() - stats.getTiming("run");
+    stats.addCounter("source lines", lines);
+    stats.addTiming("total compile time", total);
+    if (lines > 0) {
+      stats.addTiming("compile time per 1000 lines", total * 1000 / lines);
+    }
+
+    // the skipped work can't be timed, so scale the cost of the kept bodies instead
+    if (deadDecls.keptNodes > 0 && deadDecls.removedNodes > 0) {
+      auto perNode = (stats.getTiming("sema") + stats.getTiming("codegen")) /
+                     static_cast<double>(deadDecls.keptNodes);
+      stats.addTiming("est. time saved by reachability", perNode * deadDecls.removedNodes);
+    }
+
+    stats.print(std::cerr);
+  };
+
   fern::TypeVisitor typeChecker(ctx);
-  parsedProgram->typeCheck(typeChecker);
+  {
+    auto timer = ctx.getStats().time("sema");
+    parsedProgram->typeCheck(typeChecker);
+  }
 
   if (ctx.hasErrors()) {
     ctx.printErrors(errPrinter);
@@ -92,8 +426,160 @@ auto main(int argc, char **argv) -> int {
   }
   ctx.flushWarnings(errPrinter);
 
+  if (optRes.count("check")) {
+    if (optRes.count("stats")) {
+      ctx.getStats().print(std::cerr);
+    }
+    return 0;
+  }
+
+  bool fast = optRes.count("fast");
+  {
+    auto timer = ctx.getStats().time("llvm init");
+    ctx.initLLVM();
+    // names like `addtmp` are only there for reading IR dumps
+    ctx.getLLVMContext().setDiscardValueNames(fast);
+  }
+
+  std::unique_ptr<fern::JITEngine> jit;
+  llvm::TargetMachine *targetMachine = nullptr;
+  if (runMode) {
+    auto timer = ctx.getStats().time("jit setup");
+    llvm::Error err = llvm::Error::success();
+    if (optRes.count("tiered")) {
+      // -O defaults to 0, only an unset level means O2 here. an explicit -O0 is honoured
+      auto tierUpLevel = optRes.count("opt-level") ? *optLevel : fern::OptLevel::O2;
+      auto threshold = std::max<u64>(optRes["tier-up-threshold"].as<u64>(), 1);
+      auto created = fern::TieredJIT::create(tierUpLevel, threshold, optRes.count("perf-map"));
+      if (created) {
+        jit = std::move(*created);
+      } else {
+        err = created.takeError();
+      }
+    } else {
+      std::unique_ptr<fern::DiskObjectCache> cache;
+      if (!optRes.count("no-cache")) {
+        cache = std::make_unique<fern::DiskObjectCache>(
+            fern::DiskObjectCache::defaultDirectory(), optRes["cache-size"].as<u64>() << 20);
+      }
+      auto created = fern::FernJIT::create(*optLevel, std::move(cache), optRes.count("perf-map"));
+      if (created) {
+        jit = std::move(*created);
+      } else {
+        err = created.takeError();
+      }
+    }
+
+    if (err) {
+      std::cerr << fmt::format("Failed to set up the JIT: {}", llvm::toString(std::move(err)))
+                << std::endl;
+      return 1;
+    }
+    ctx.getModule().setDataLayout(jit->getDataLayout());
+  } else {
+    auto created = ctx.getTargetMachine();
+    if (!created) {
+      std::cerr << fmt::format("Failed to set up the target: {}",
+                               llvm::toString(created.takeError()))
+                << std::endl;
+      return 1;
+    }
+    targetMachine = &*created;
+
+    switch (*optLevel) {
+    case fern::OptLevel::O0:
+      targetMachine->setOptLevel(llvm::CodeGenOpt::None);
+      // targets that default to GlobalISel at -O0 keep it, everything else gets
+      // FastISel instead of falling back to SelectionDAG
+      if (fast && !targetMachine->Options.EnableGlobalISel) {
+        targetMachine->setO0WantsFastISel(true);
+        targetMachine->setFastISel(true);
+      }
+      break;
+    case fern::OptLevel::O1:
+      targetMachine->setOptLevel(llvm::CodeGenOpt::Less);
+      break;
+    case fern::OptLevel::O3:
+      targetMachine->setOptLevel(llvm::CodeGenOpt::Aggressive);
+      break;
+    default:
+      targetMachine->setOptLevel(llvm::CodeGenOpt::Default);
+      break;
+    }
+
+    // moves the blocks a profile never saw into `.text.split.` sections
+    if (profile.mode == fern::ProfileOptions::Mode::Use &&
+        (*optLevel == fern::OptLevel::O2 || *optLevel == fern::OptLevel::O3) &&
+        targetMachine->getTargetTriple().isOSBinFormatELF()) {
+      targetMachine->Options.EnableMachineFunctionSplitter = true;
+    }
+    ctx.getModule().setTargetTriple(targetMachine->getTargetTriple().str());
+    ctx.getModule().setDataLayout(targetMachine->createDataLayout());
+  }
+
+  fern::AttributeInference attrInference;
+  {
+    auto timer = ctx.getStats().time("attribute inference");
+    attrInference.run(*parsedProgram);
+  }
+
   fern::CodegenVisitor codegen(ctx);
-  parsedProgram->codegen(codegen);
+  codegen.setAttributeInference(&attrInference);
+  codegen.setFastMath(optRes.count("fast-math"));
+  // the JIT's target machine is the host's, only what was asked for goes on functions
+  if (targetMachine) {
+    codegen.setTargetAttributes(targetMachine->getTargetCPU().str(),
+                                targetMachine->getTargetFeatureString().str());
+  } else if (!targetSpec.isDefaultCPU()) {
+    codegen.setTargetAttributes(targetSpec.cpu, targetSpec.features);
+  }
+  // builds with asserts always verify. DEBUG_INFO is also set for RelWithDebInfo
+#ifdef NDEBUG
+  codegen.setVerifyFunctions(!fast);
+#endif
+
+  auto debugLevel = optRes.count("gline-tables-only") ? fern::DebugInfoLevel::LineTablesOnly
+                    : optRes.count("debug")           ? fern::DebugInfoLevel::Full
+                                                      : fern::DebugInfoLevel::None;
+  // remarks need locations to point at, even when no DWARF is wanted
+  if (debugLevel == fern::DebugInfoLevel::None && remarks) {
+    debugLevel = fern::DebugInfoLevel::LocationsOnly;
+  }
+  std::unique_ptr<fern::DebugInfo> debugInfo;
+  if (debugLevel != fern::DebugInfoLevel::None) {
+    debugInfo = std::make_unique<fern::DebugInfo>(ctx.getModule(), ifile, debugLevel,
+                                                  *optLevel != fern::OptLevel::O0);
+    codegen.setDebugInfo(debugInfo.get());
+  }
+  if (optRes.count("fir")) {
+    fern::fir::Module firModule;
+    {
+      auto timer = ctx.getStats().time("fir lowering");
+      firModule = fern::fir::lowerProgram(*parsedProgram, ctx);
+    }
+
+    auto passes = fern::fir::PassManager::buildDefaultPipeline(&attrInference, &ctx.getStats());
+    passes.run(firModule);
+
+    if (hasDebugPass("fir")) {
+      std::cout << "FIR:" << std::endl;
+      firModule.print(llvm::outs());
+      llvm::outs().flush();
+    }
+
+    auto timer = ctx.getStats().time("codegen");
+    fern::fir::lowerToLLVM(firModule, ctx, codegen, &attrInference);
+  } else {
+    auto timer = ctx.getStats().time("codegen");
+    parsedProgram->codegen(codegen);
+  }
+
+  // the builder tracks metadata owned by the module, which may be handed to the JIT
+  if (debugInfo) {
+    debugInfo->finalize();
+    codegen.setDebugInfo(nullptr);
+    debugInfo.reset();
+  }
 
   if (ctx.hasErrors()) {
     ctx.printErrors(errPrinter);
@@ -101,8 +587,244 @@ auto main(int argc, char **argv) -> int {
   }
   ctx.flushWarnings(errPrinter);
 
-  // print the LLVM IR
-  ctx.getModule().print(llvm::errs(), nullptr);
+  {
+    auto timer = ctx.getStats().time("multiversioning");
+    auto dispatch = fern::CloneDispatch::Host;
+    if (targetMachine) {
+      auto &triple = targetMachine->getTargetTriple();
+      dispatch = triple.isX86() && triple.isOSBinFormatELF() ? fern::CloneDispatch::IFunc
+                                                             : fern::CloneDispatch::Default;
+    }
+
+    auto cloned = fern::emitTargetClones(ctx.getModule(), dispatch);
+    if (!cloned) {
+      std::cerr << llvm::toString(cloned.takeError()) << std::endl;
+      return 1;
+    }
+    if (*cloned > 0 && dispatch == fern::CloneDispatch::Default) {
+      auto message = fmt::format("`@target_clones` needs an x86 ELF target, only the default "
+                                 "version is used for {}",
+                                 targetMachine->getTargetTriple().str());
+      for (auto &func: parsedProgram->getFunctions()) {
+        if (auto clones = func->getProto()->getAnnotation("target_clones")) {
+          ctx.recordWarning(message, clones->loc);
+        }
+      }
+      ctx.flushWarnings(errPrinter);
+    }
+    ctx.getStats().addCounter("multiversioned functions", *cloned);
+  }
+
+  if (runMode) {
+    if (hasDebugPass("codegen")) {
+      ctx.getModule().print(llvm::errs(), nullptr);
+    }
+
+    auto mainFunc = ctx.getModule().getFunction("main");
+    if (!mainFunc || mainFunc->isDeclaration()) {
+      std::cerr << "No `main` function to run" << std::endl;
+      return 1;
+    }
+    bool returnsVoid = mainFunc->getReturnType()->isVoidTy();
+
+    auto [llvmContext, llvmModule] = ctx.takeLLVM();
+    if (auto err = jit->addModule(std::move(llvmContext), std::move(llvmModule))) {
+      std::cerr << fmt::format("Failed to JIT: {}", llvm::toString(std::move(err))) << std::endl;
+      return 1;
+    }
+
+    auto exitCode = [&] {
+      auto timer = ctx.getStats().time("run");
+      return jit->runMain(ifile, programArgs, returnsVoid);
+    }();
+    if (!exitCode) {
+      std::cerr << fmt::format("Failed to run: {}", llvm::toString(exitCode.takeError()))
+                << std::endl;
+      return 1;
+    }
+
+    printStats();
+    if (optRes.count("jit-stats")) {
+      jit->printStats(std::cerr);
+    }
+    return *exitCode;
+  }
 
+  auto reportRemarks = [&] {
+    if (!remarks) {
+      return true;
+    }
+
+    remarks->print(errPrinter);
+    ctx.getStats().addCounter("optimization remarks", remarks->size());
+    if (optRes.count("remarks-output")) {
+      auto path = optRes["remarks-output"].as<std::string>();
+      if (auto err = remarks->serialize(path, remarksFormat)) {
+        std::cerr << llvm::toString(std::move(err)) << std::endl;
+        return false;
+      }
+    }
+    return true;
+  };
+  if (remarks) {
+    remarks->install(ctx.getLLVMContext());
+  }
+
+  auto pipeline = optRes.count("passes") ? optRes["passes"].as<std::string>() : "";
+  auto ofile = optRes.count("output") ? optRes["output"].as<std::string>()
+                                      : fern::defaultOutputPath(ifile, *emitKind);
+
+  // objects are left for whoever links them to provide a runtime
+  std::vector<std::string> linkArgs;
+  std::vector<std::string> tempFiles;
+  auto removeTempFiles = llvm::make_scope_exit([&] {
+    for (auto &file: tempFiles) {
+      llvm::sys::fs::remove(file);
+    }
+  });
+  if (profile.mode == fern::ProfileOptions::Mode::Generate &&
+      *emitKind == fern::EmitKind::Executable) {
+    auto runtime = fern::writeProfileRuntime();
+    if (!runtime) {
+      std::cerr << llvm::toString(runtime.takeError()) << std::endl;
+      return 1;
+    }
+    tempFiles.push_back(*runtime);
+    linkArgs.push_back(*runtime);
+  }
+
+  // lld can put the hot functions next to each other, which needs each of them in its
+  // own section. other linkers only get the module order from `layoutFunctions`
+  auto symbolOrder = optRes.count("symbol-order") ? optRes["symbol-order"].as<std::string>()
+                                                  : "";
+  bool hasHot = profile.mode == fern::ProfileOptions::Mode::Use ||
+                llvm::any_of(ctx.getModule(), [](auto &func) {
+                  return func.hasFnAttribute(llvm::Attribute::Hot);
+                });
+  auto &triple = targetMachine->getTargetTriple();
+  bool inProcess =
+      *emitKind == fern::EmitKind::Executable && fern::linksInProcess(triple, linkArgs);
+  if (*emitKind == fern::EmitKind::Executable && hasHot && triple.isOSBinFormatELF() &&
+      (inProcess || llvm::sys::findProgramByName("ld.lld"))) {
+    if (symbolOrder.empty()) {
+      llvm::SmallString<128> path;
+      if (auto ec = llvm::sys::fs::createTemporaryFile("fern", "order", path)) {
+        std::cerr << fmt::format("Failed to create a symbol order file: {}", ec.message())
+                  << std::endl;
+        return 1;
+      }
+      symbolOrder = path.str().str();
+      tempFiles.push_back(symbolOrder);
+    }
+    targetMachine->Options.FunctionSections = true;
+    linkArgs.insert(linkArgs.end(), {"-fuse-ld=lld", "-Wl,--symbol-ordering-file=" + symbolOrder,
+                                     "-Wl,--no-warn-symbol-ordering"});
+  }
+
+  // the embedded lld drops unreferenced sections and folds identical functions, both of
+  // which work per section. the address significance table keeps `--icf=safe` from
+  // folding functions whose address is compared
+  if (inProcess) {
+    targetMachine->Options.FunctionSections = true;
+    targetMachine->Options.DataSections = true;
+    targetMachine->Options.EmitAddrsig = true;
+  }
+
+  // the partitions are never put back together as IR, so there's nothing to print
+  auto jobs = optRes["jobs"].as<u32>();
+  if (jobs > 1 && fern::ParallelBackend::supports(*emitKind) && ofile != "-" &&
+      !hasDebugPass("codegen") && !thinLTO) {
+    {
+      auto timer = ctx.getStats().time("parallel backend");
+      fern::ParallelBackend backend(*optLevel, pipeline, *targetMachine, jobs);
+      backend.setProfile(profile);
+      backend.setLinkArgs(linkArgs);
+      backend.setSymbolOrder(symbolOrder);
+      backend.setRemarks(remarks.get());
+      if (auto err = backend.run(ctx.getModule(), *emitKind, ofile)) {
+        std::cerr << fmt::format("Failed to write {}: {}", ofile, llvm::toString(std::move(err)))
+                  << std::endl;
+        return 1;
+      }
+    }
+
+    if (!reportRemarks()) {
+      return 1;
+    }
+    printStats();
+    return 0;
+  }
+
+  {
+    auto timer = ctx.getStats().time("optimization");
+    fern::Optimizer optimizer(*optLevel, pipeline, targetMachine);
+    optimizer.setProfile(profile);
+    optimizer.setThinLTOPreLink(thinLTO);
+    if (auto err = optimizer.run(ctx.getModule())) {
+      std::cerr << fmt::format("Invalid pass pipeline: {}", llvm::toString(std::move(err)))
+                << std::endl;
+      return 1;
+    }
+  }
+
+  {
+    auto timer = ctx.getStats().time("function layout");
+    auto hot = fern::layoutFunctions(ctx.getModule());
+    if (!symbolOrder.empty()) {
+      if (auto err = fern::writeSymbolOrder(std::move(hot), symbolOrder)) {
+        std::cerr << llvm::toString(std::move(err)) << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  if (hasDebugPass("codegen")) {
+    ctx.getModule().print(llvm::errs(), nullptr);
+  }
+
+  // a ThinLTO executable is this file's unit put through `fern link` on its own
+  if (thinLTO && *emitKind == fern::EmitKind::Executable) {
+    llvm::SmallString<128> unit;
+    if (auto ec = llvm::sys::fs::createTemporaryFile("fern", "bc", unit)) {
+      std::cerr << fmt::format("Failed to create a temporary file: {}", ec.message())
+                << std::endl;
+      return 1;
+    }
+    tempFiles.push_back(unit.str().str());
+
+    auto timer = ctx.getStats().time("thin link");
+    fern::ThinLTOLinker linker(*optLevel, jobs);
+    if (!optRes.count("no-cache")) {
+      linker.setCache(fern::ThinLTOLinker::defaultCacheDirectory(),
+                      optRes["cache-size"].as<u64>() << 20);
+    }
+    std::vector<std::string> inputs{unit.str().str()};
+    inputs.insert(inputs.end(), linkArgs.begin(), linkArgs.end());
+    auto err = fern::writeThinLTOBitcode(ctx.getModule(), unit.str().str());
+    if (!err) {
+      err = linker.run(inputs, ofile);
+    }
+    if (err) {
+      std::cerr << fmt::format("Failed to write {}: {}", ofile, llvm::toString(std::move(err)))
+                << std::endl;
+      return 1;
+    }
+    ctx.getStats().addCounter("thin LTO cache hits", linker.getCacheHits());
+  } else {
+    auto timer = ctx.getStats().time("emission");
+    auto err = thinLTO ? fern::writeThinLTOBitcode(ctx.getModule(), ofile)
+                       : fern::emitModule(ctx.getModule(), *targetMachine, *emitKind, ofile,
+                                          linkArgs);
+    if (err) {
+      std::cerr << fmt::format("Failed to write {}: {}", ofile, llvm::toString(std::move(err)))
+                << std::endl;
+      return 1;
+    }
+  }
+
+  if (!reportRemarks()) {
+    return 1;
+  }
+  printStats();
   return 0;
 }